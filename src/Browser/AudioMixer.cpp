@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioMixer.h"
+#include "AudioHardware.h"
+#include "AudioMixerProtocol.h"
+#include "AudioRingBuffer.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <errno.h>
+#include <glib-unix.h>
+#include <gst/app/gstappsrc.h>
+#include <iomanip>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef GST_API_VERSION_1
+#include <gst/audio/audio.h>
+#endif
+
+static const size_t periodBytes = AudioMixerProtocol::periodFrames * AudioMixerProtocol::channels * sizeof(float);
+
+static uint64_t now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void needDataCallback(GstAppSrc*, guint, gpointer mixer)
+{
+    static_cast<AudioMixer*>(mixer)->needData();
+}
+
+AudioMixer::AudioMixer()
+    : m_listenSocket(-1)
+    , m_listenWatch(0)
+    , m_sampleRate(0)
+    , m_pipeline(0)
+    , m_appSource(0)
+#ifdef GST_API_VERSION_1
+    , m_pool(0)
+#endif
+    , m_statsTimer(0)
+    , m_runningStreams(0)
+    , m_playing(false)
+    , m_framesMixed(0)
+    , m_periods(0)
+    , m_streamPeriods(0)
+    , m_mixTime(0)
+    , m_mixTimeMax(0)
+{
+    const char* enabled = getenv("DROWSER_AUDIO_MIXER");
+    if (!enabled || !*enabled || !strcmp(enabled, "0"))
+        return;
+
+    if (!gst_init_check(0, 0, 0)) {
+        std::cerr << "Can't initialize GStreamer, web processes will play on their own." << std::endl;
+        return;
+    }
+    // Web processes create their contexts at the rate they probe the same way,
+    // and only join the mixer when it matches ours.
+    m_sampleRate = AudioHardware::get().sampleRate;
+    if (!buildPipeline()) {
+        std::cerr << "Can't build the audio mixer pipeline, web processes will play on their own." << std::endl;
+        return;
+    }
+    if (!listen())
+        return;
+
+    if (const char* interval = getenv("DROWSER_AUDIO_STATS_INTERVAL")) {
+        if (unsigned seconds = atoi(interval)) {
+            m_statsTimer = g_timeout_add_seconds(seconds, [](gpointer mixer) -> gboolean {
+                static_cast<AudioMixer*>(mixer)->printStats(std::cerr);
+                return TRUE;
+            }, this);
+        }
+    }
+}
+
+AudioMixer::~AudioMixer()
+{
+    if (m_statsTimer)
+        g_source_remove(m_statsTimer);
+    if (m_listenWatch)
+        g_source_remove(m_listenWatch);
+    if (m_listenSocket >= 0)
+        close(m_listenSocket);
+
+    if (m_pipeline) {
+        gst_element_set_state(m_pipeline, GST_STATE_NULL);
+        gst_object_unref(m_pipeline);
+        m_pipeline = 0;
+    }
+#ifdef GST_API_VERSION_1
+    if (m_pool)
+        gst_object_unref(m_pool);
+#endif
+
+    while (!m_streams.empty())
+        removeStream(m_streams.back());
+}
+
+bool AudioMixer::listen()
+{
+    m_listenSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_listenSocket < 0)
+        return false;
+
+    // Abstract socket, so there's no file to clean up if we crash.
+    char name[64];
+    snprintf(name, sizeof(name), "drowser-audio-%d", getpid());
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path + 1, name, strlen(name));
+    if (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), offsetof(sockaddr_un, sun_path) + 1 + strlen(name))
+        || ::listen(m_listenSocket, 16)) {
+        std::cerr << "Can't listen for audio mixer clients: " << strerror(errno) << std::endl;
+        close(m_listenSocket);
+        m_listenSocket = -1;
+        return false;
+    }
+
+    m_listenWatch = g_unix_fd_add(m_listenSocket, G_IO_IN, [](gint, GIOCondition, gpointer mixer) -> gboolean {
+        static_cast<AudioMixer*>(mixer)->acceptConnection();
+        return TRUE;
+    }, this);
+
+    // Web processes inherit our environment.
+    char rate[16];
+    snprintf(rate, sizeof(rate), "%u", m_sampleRate);
+    setenv(AudioMixerProtocol::socketNameVariable, name, 1);
+    setenv(AudioMixerProtocol::sampleRateVariable, rate, 1);
+    return true;
+}
+
+bool AudioMixer::buildPipeline()
+{
+    m_appSource = gst_element_factory_make("appsrc", 0);
+    GstElement* audioConvert = gst_element_factory_make("audioconvert", 0);
+    GstElement* audioSink = gst_element_factory_make("autoaudiosink", 0);
+    if (!m_appSource || !audioConvert || !audioSink) {
+        GstElement* elements[] = { m_appSource, audioConvert, audioSink };
+        for (GstElement* element : elements) {
+            if (element)
+                gst_object_unref(element);
+        }
+        m_appSource = 0;
+        return false;
+    }
+
+#ifdef GST_API_VERSION_1
+    GstCaps* caps = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, GST_AUDIO_NE(F32),
+                                        "layout", G_TYPE_STRING, "interleaved",
+                                        "rate", G_TYPE_INT, m_sampleRate,
+                                        "channels", G_TYPE_INT, AudioMixerProtocol::channels,
+                                        "channel-mask", GST_TYPE_BITMASK, G_GUINT64_CONSTANT(0x3), NULL);
+#else
+    GstCaps* caps = gst_caps_new_simple("audio/x-raw-float", "width", G_TYPE_INT, 32,
+                                        "endianness", G_TYPE_INT, G_BYTE_ORDER,
+                                        "rate", G_TYPE_INT, m_sampleRate,
+                                        "channels", G_TYPE_INT, AudioMixerProtocol::channels, NULL);
+#endif
+    gst_app_src_set_caps(GST_APP_SRC(m_appSource), caps);
+
+#ifdef GST_API_VERSION_1
+    m_pool = gst_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(m_pool);
+    gst_buffer_pool_config_set_params(config, caps, periodBytes, 4, 0);
+    gst_buffer_pool_set_config(m_pool, config);
+    gst_buffer_pool_set_active(m_pool, TRUE);
+#endif
+    gst_caps_unref(caps);
+
+    // Two periods queued in appsrc, the sink buffers the rest.
+    g_object_set(m_appSource, "format", GST_FORMAT_TIME, "max-bytes", static_cast<guint64>(2 * periodBytes), NULL);
+    GstAppSrcCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.need_data = needDataCallback;
+    gst_app_src_set_callbacks(GST_APP_SRC(m_appSource), &callbacks, this, 0);
+
+    m_pipeline = gst_pipeline_new("mixer");
+    gst_bin_add_many(GST_BIN(m_pipeline), m_appSource, audioConvert, audioSink, NULL);
+    gst_element_link_many(m_appSource, audioConvert, audioSink, NULL);
+    return true;
+}
+
+void AudioMixer::acceptConnection()
+{
+    int clientSocket = accept4(m_listenSocket, 0, 0, SOCK_CLOEXEC);
+    if (clientSocket < 0)
+        return;
+
+    Stream* stream = new Stream();
+    stream->mixer = this;
+    stream->socket = clientSocket;
+    stream->eventFd = -1;
+    stream->memory = MAP_FAILED;
+    stream->memorySize = 0;
+    stream->ring = 0;
+    stream->running = false;
+    stream->watch = g_unix_fd_add(clientSocket, static_cast<GIOCondition>(G_IO_IN | G_IO_HUP | G_IO_ERR), [](gint, GIOCondition, gpointer data) -> gboolean {
+        Stream* stream = static_cast<Stream*>(data);
+        if (stream->mixer->handleMessage(stream))
+            return TRUE;
+        // removeStream() deletes the stream and this source with it.
+        stream->watch = 0;
+        stream->mixer->removeStream(stream);
+        return FALSE;
+    }, stream);
+
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    m_streams.push_back(stream);
+}
+
+bool AudioMixer::handleMessage(Stream* stream)
+{
+    AudioMixerProtocol::Message message;
+    int descriptors[AudioMixerProtocol::maximumDescriptors];
+    unsigned descriptorCount;
+    if (!AudioMixerProtocol::receiveMessage(stream->socket, message, descriptors, descriptorCount))
+        return false;
+
+    switch (message.type) {
+    case AudioMixerProtocol::Hello: {
+        // Unless the client sealed the memfd it could shrink it later and make us fault on the mapping.
+        struct stat status;
+        int seals = descriptorCount ? fcntl(descriptors[0], F_GET_SEALS) : -1;
+        bool valid = !stream->ring && descriptorCount == 2
+            && seals >= 0 && (seals & AudioMixerProtocol::requiredSeals) == AudioMixerProtocol::requiredSeals
+            && !fstat(descriptors[0], &status) && static_cast<size_t>(status.st_size) >= message.memorySize;
+        void* memory = valid ? mmap(0, message.memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, descriptors[0], 0) : MAP_FAILED;
+        if (memory == MAP_FAILED) {
+            for (unsigned i = 0; i < descriptorCount; ++i)
+                close(descriptors[i]);
+            return false;
+        }
+        close(descriptors[0]);
+
+        AudioRingBuffer* ring = new AudioRingBuffer(memory, message.memorySize);
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        stream->memory = memory;
+        stream->memorySize = message.memorySize;
+        stream->eventFd = descriptors[1];
+        if (!ring->isValid() || ring->channels() != AudioMixerProtocol::channels) {
+            delete ring;
+            return false;
+        }
+        stream->ring = ring;
+        return true;
+    }
+    case AudioMixerProtocol::Start:
+    case AudioMixerProtocol::Stop: {
+        for (unsigned i = 0; i < descriptorCount; ++i)
+            close(descriptors[i]);
+        bool running = message.type == AudioMixerProtocol::Start;
+        if (!stream->ring || stream->running == running)
+            return !!stream->ring;
+        {
+            std::lock_guard<std::mutex> lock(m_streamsMutex);
+            stream->running = running;
+            m_runningStreams += running ? 1 : -1;
+        }
+        updatePipelineState();
+        return true;
+    }
+    default:
+        for (unsigned i = 0; i < descriptorCount; ++i)
+            close(descriptors[i]);
+        return false;
+    }
+}
+
+void AudioMixer::removeStream(Stream* stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        m_streams.erase(std::find(m_streams.begin(), m_streams.end(), stream));
+        if (stream->running)
+            m_runningStreams--;
+    }
+    // Out of the list, the streaming thread can't see it anymore.
+    updatePipelineState();
+
+    if (stream->watch)
+        g_source_remove(stream->watch);
+    delete stream->ring;
+    if (stream->memory != MAP_FAILED)
+        munmap(stream->memory, stream->memorySize);
+    if (stream->eventFd >= 0)
+        close(stream->eventFd);
+    close(stream->socket);
+    delete stream;
+}
+
+void AudioMixer::updatePipelineState()
+{
+    // Nothing to play, so let the sink preroll and the streaming thread sleep
+    // rather than mixing silence.
+    bool playing = m_runningStreams;
+    if (!m_pipeline || playing == m_playing)
+        return;
+    m_playing = playing;
+    gst_element_set_state(m_pipeline, playing ? GST_STATE_PLAYING : GST_STATE_PAUSED);
+}
+
+GstBuffer* AudioMixer::acquireBuffer()
+{
+#ifdef GST_API_VERSION_1
+    GstBuffer* buffer = 0;
+    if (gst_buffer_pool_acquire_buffer(m_pool, &buffer, 0) != GST_FLOW_OK)
+        return 0;
+    return buffer;
+#else
+    return gst_buffer_new_and_alloc(periodBytes);
+#endif
+}
+
+void AudioMixer::needData()
+{
+    GstBuffer* buffer = acquireBuffer();
+    if (!buffer)
+        return;
+
+    uint64_t start = now();
+#ifdef GST_API_VERSION_1
+    GstMapInfo info;
+    gst_buffer_map(buffer, &info, GST_MAP_WRITE);
+    float* mix = reinterpret_cast<float*>(info.data);
+#else
+    float* mix = reinterpret_cast<float*>(GST_BUFFER_DATA(buffer));
+#endif
+    const size_t samples = AudioMixerProtocol::periodFrames * AudioMixerProtocol::channels;
+    memset(mix, 0, periodBytes);
+
+    {
+        // Streams only come and go from the main thread, this is never contended for long.
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        float scratch[samples];
+        for (Stream* stream : m_streams) {
+            if (!stream->running)
+                continue;
+            // read() zero fills on underrun, so a late stream just drops out.
+            stream->ring->read(scratch, AudioMixerProtocol::periodFrames);
+            VectorMath::add(scratch, mix, samples);
+            uint64_t one = 1;
+            if (write(stream->eventFd, &one, sizeof(one)) < 0) {
+                // Only fails if the counter is saturated, the client is awake anyway.
+            }
+            m_streamPeriods++;
+        }
+    }
+
+#ifdef GST_API_VERSION_1
+    gst_buffer_unmap(buffer, &info);
+#endif
+    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale_int(m_framesMixed, GST_SECOND, m_sampleRate);
+    m_framesMixed += AudioMixerProtocol::periodFrames;
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale_int(m_framesMixed, GST_SECOND, m_sampleRate) - GST_BUFFER_TIMESTAMP(buffer);
+
+    uint64_t elapsed = now() - start;
+    m_mixTime += elapsed;
+    m_mixTimeMax = std::max(m_mixTimeMax, elapsed);
+    m_periods++;
+
+    gst_app_src_push_buffer(GST_APP_SRC(m_appSource), buffer);
+}
+
+void AudioMixer::printStats(std::ostream& out)
+{
+    unsigned streams;
+    unsigned running;
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        streams = m_streams.size();
+        running = m_runningStreams;
+    }
+
+    out << "[Audio mixer] " << streams << " streams, " << running << " running, " << m_periods << " periods";
+    if (m_periods) {
+        out << std::fixed << std::setprecision(1)
+            << ", " << static_cast<double>(m_streamPeriods) / m_periods << " streams per period"
+            << ", mix avg " << m_mixTime / m_periods / 1000.0 << "us max " << m_mixTimeMax / 1000.0 << "us";
+    }
+    out << std::endl;
+}
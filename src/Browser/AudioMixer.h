@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioMixer_h
+#define AudioMixer_h
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <mutex>
+#include <ostream>
+#include <stdint.h>
+#include <vector>
+
+class AudioRingBuffer;
+
+// Plays the Web Audio output of all web processes through a single pipeline,
+// instead of one pipeline and sound server stream per AudioContext. Web
+// processes render into rings shared with us, see AudioMixerProtocol.h, and the
+// streaming thread of our appsrc sums every running stream into each buffer.
+// It's only enabled with DROWSER_AUDIO_MIXER=1, and must be created before any
+// web process is spawned since they find the mixer through the environment.
+class AudioMixer
+{
+public:
+    AudioMixer();
+    ~AudioMixer();
+
+    bool isEnabled() const { return m_listenSocket >= 0; }
+
+    void printStats(std::ostream&);
+    void needData();
+
+private:
+    struct Stream {
+        AudioMixer* mixer;
+        int socket;
+        guint watch;
+        int eventFd;
+        void* memory;
+        size_t memorySize;
+        AudioRingBuffer* ring;
+        bool running;
+    };
+
+    bool listen();
+    bool buildPipeline();
+    void acceptConnection();
+    bool handleMessage(Stream*);
+    void removeStream(Stream*);
+    void updatePipelineState();
+    GstBuffer* acquireBuffer();
+
+    int m_listenSocket;
+    guint m_listenWatch;
+    unsigned m_sampleRate;
+    GstElement* m_pipeline;
+    GstElement* m_appSource;
+#ifdef GST_API_VERSION_1
+    GstBufferPool* m_pool;
+#endif
+    guint m_statsTimer;
+
+    // The streaming thread mixes while the main thread adds and removes streams.
+    std::mutex m_streamsMutex;
+    std::vector<Stream*> m_streams;
+    unsigned m_runningStreams;
+    bool m_playing;
+
+    // Only touched by the streaming thread, read without locking for the stats.
+    uint64_t m_framesMixed;
+    uint64_t m_periods;
+    uint64_t m_streamPeriods;
+    uint64_t m_mixTime;
+    uint64_t m_mixTimeMax;
+};
+
+#endif
@@ -36,17 +36,22 @@
 #include <GL/gl.h>
 #include <cairo.h>
 #include <glib.h>
+#include <glib-unix.h>
 #include <cassert>
 #include <cstdio>
 #include <cstring>
 #include <unistd.h>
 #include <cstdlib>
+#include <csignal>
+#include <iostream>
 #include <libgen.h>
 #include <limits.h>
 #include <string>
 #include <vector>
 
+#include "AudioMixer.h"
 #include "FatalError.h"
+#include "IPCTracer.h"
 #include "InjectedBundleGlue.h"
 #include "Tab.h"
 
@@ -58,6 +63,10 @@ Browser::Browser(const std::vector<std::string>& urls)
     , m_toolBarHeight(0)
     , m_currentTab(-1)
     , m_initialUrls(urls)
+    , m_ipcTraceTimer(0)
+    , m_ipcDumpSignal(0)
+    // Before any web process is spawned, they look for the mixer in the environment.
+    , m_audioMixer(new AudioMixer)
 {
     m_mainLoop = g_main_loop_new(0, false);
 
@@ -66,6 +75,11 @@ Browser::Browser(const std::vector<std::string>& urls)
 
 Browser::~Browser()
 {
+    if (m_ipcTraceTimer)
+        g_source_remove(m_ipcTraceTimer);
+    if (m_ipcDumpSignal)
+        g_source_remove(m_ipcDumpSignal);
+
     for (std::pair<const int, Tab*> p : m_tabs)
         delete p.second;
     m_tabs.clear();
@@ -76,6 +90,7 @@ Browser::~Browser()
     WKRelease(m_uiContext);
     delete m_window;
     delete m_glue;
+    delete m_audioMixer;
 }
 
 std::string getApplicationPath()
@@ -153,6 +168,7 @@ void Browser::initUi()
     m_glue->bind("_loadUrl", this, &Browser::loadUrlOnCurrentTab);
     m_glue->bindToDispatcher("_reload", this, &Tab::reload);
     m_glue->bindToDispatcher("_back", this, &Tab::back);
+    initIpcTrace();
 
     std::string uiHtml = getUiFile();
     WKURLRef wkUrl = WKURLCreateWithUTF8CString(("file://" + uiHtml).c_str());
@@ -167,6 +183,48 @@ void Browser::initUi()
     WKPreferencesSetWebGLEnabled(webPreferences, true);
 }
 
+void Browser::initIpcTrace()
+{
+    IPCTracer& tracer = IPCTracer::instance();
+    if (!tracer.isEnabled())
+        return;
+
+    tracer.setProcessName("Browser");
+    m_glue->bind("_ipcPong", this, &Browser::ipcPong);
+    m_glue->bind("_dumpIpcStats", this, &Browser::dumpIpcStats);
+
+    if (tracer.summaryInterval()) {
+        m_ipcTraceTimer = g_timeout_add_seconds(tracer.summaryInterval(), [](gpointer data) -> gboolean {
+            ((Browser*)data)->ipcTraceTick();
+            return TRUE;
+        }, this);
+    }
+
+    // kill -USR1 dumps the full trace of the browser and the UI process.
+    m_ipcDumpSignal = g_unix_signal_add(SIGUSR1, [](gpointer data) -> gboolean {
+        ((Browser*)data)->dumpIpcStats();
+        return TRUE;
+    }, this);
+}
+
+void Browser::ipcTraceTick()
+{
+    // The UI bundle echoes the ping back as _ipcPong, which gives us the round trip latency.
+    postToBundle(m_uiPage, "_ipcPing", static_cast<double>(IPCTracer::now()));
+    IPCTracer::instance().printSummary(std::cerr);
+}
+
+void Browser::ipcPong(const double& pingTime)
+{
+    IPCTracer::instance().recordRoundTrip(IPCTracer::now() - static_cast<uint64_t>(pingTime));
+}
+
+void Browser::dumpIpcStats()
+{
+    IPCTracer::instance().dump(std::cerr);
+    postToBundle(m_uiPage, "_dumpIpcStats");
+}
+
 int Browser::run()
 {
     g_main_loop_run(m_mainLoop);
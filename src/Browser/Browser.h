@@ -33,6 +33,7 @@
 #include <string>
 #include <vector>
 
+class AudioMixer;
 class Tab;
 
 std::string getApplicationPath();
@@ -70,6 +71,8 @@ public:
     void setCurrentTab(const int& tabId);
     void loadUrlOnCurrentTab(const std::string& url);
     Tab* currentTab();
+    void dumpIpcStats();
+    void ipcPong(const double& pingTime);
 
     template<typename Param, typename Obj>
     void dispatchMessage(const Param& param, void (Obj::*method)(const Param&));
@@ -105,11 +108,17 @@ private:
 
     const std::vector<std::string>& m_initialUrls;
 
+    guint m_ipcTraceTimer;
+    guint m_ipcDumpSignal;
+    AudioMixer* m_audioMixer;
+
     template<typename T>
     bool sendMouseEventToPage(T event);
 
     void updateDisplay();
     void initUi();
+    void initIpcTrace();
+    void ipcTraceTick();
 
     friend gboolean callUpdateDisplay(gpointer);
 };
@@ -25,7 +25,6 @@
 
 #include "InjectedBundleGlue.h"
 #include <cstring>
-#include <stdexcept>
 #include <iostream>
 #include <vector>
 #include <WebKit2/WKNumber.h>
@@ -37,8 +36,7 @@ static void didReceiveMessageFromInjectedBundle(WKContextRef page, WKStringRef m
 {
     InjectedBundleGlue* self = reinterpret_cast<InjectedBundleGlue*>(const_cast<void*>(clientInfo));
 
-    std::string name = fromWK<std::string>(messageName);
-    self->call(name, messageBody);
+    self->call(fromWK<StringView>(messageName), messageBody);
 }
 }
 
@@ -52,11 +50,25 @@ InjectedBundleGlue::InjectedBundleGlue(WKContextRef context)
     WKContextSetInjectedBundleClient(context, &bundleClient);
 }
 
-void InjectedBundleGlue::call(const std::string& messageName, WKTypeRef param) const
+void InjectedBundleGlue::call(StringView messageName, WKTypeRef param) const
 {
-    try {
-        m_bindMap.at(messageName)(param);
-    } catch (std::out_of_range&) {
-        std::cerr << "Unknown message from injected bundle: " << messageName << std::endl;
+    IPCTracer& tracer = IPCTracer::instance();
+    uint64_t start = tracer.isEnabled() ? IPCTracer::now() : 0;
+
+    // Every bound name is interned, so a name missing from the pool can't be bound.
+    const char* name = StringPool::find(messageName);
+    BindMap::const_iterator it = name ? m_bindMap.find(name) : m_bindMap.end();
+    if (it == m_bindMap.end()) {
+        std::cerr << "Unknown message from injected bundle: " << messageName.data << std::endl;
+        if (tracer.isEnabled())
+            tracer.record(IPCTracer::Incoming, messageName, IPCTracer::payloadSize(param), IPCTracer::now() - start);
+        return;
     }
+
+    // messageName points into the conversion scratch buffer, which the handler
+    // reuses as soon as it converts its own arguments, so only the interned name
+    // is still valid afterwards.
+    it->second(param);
+    if (tracer.isEnabled())
+        tracer.record(IPCTracer::Incoming, name, IPCTracer::payloadSize(param), IPCTracer::now() - start);
 }
@@ -33,6 +33,8 @@
 #include <WebKit2/WKPage.h>
 #include <WebKit2/WKMutableArray.h>
 #include <WebKit2/WKString.h>
+#include "IPCTracer.h"
+#include "StringPool.h"
 #include "WKConversions.h"
 
 inline WKTypeRef createArg() { return 0; }
@@ -52,8 +54,15 @@ WKTypeRef createArg(WKTypeRef first, T...t)
 template<typename ...T>
 static void postToBundle(WKPageRef page, const char* message, const T& ... values)
 {
+    IPCTracer& tracer = IPCTracer::instance();
+    uint64_t start = tracer.isEnabled() ? IPCTracer::now() : 0;
+
     WKStringRef wkMessage = WKStringCreateWithUTF8CString(message);
-    WKPagePostMessageToInjectedBundle(page, wkMessage, createArg(toWK(values)...));
+    WKTypeRef arg = createArg(toWK(values)...);
+    if (tracer.isEnabled())
+        tracer.record(IPCTracer::Outgoing, message, IPCTracer::payloadSize(arg), IPCTracer::now() - start);
+
+    WKPagePostMessageToInjectedBundle(page, wkMessage, arg);
     WKRelease(wkMessage);
 }
 
@@ -65,7 +74,7 @@ public:
     template<typename Return, typename Obj, typename Param>
     void bind(const char* messageName, Obj* obj, Return (Obj::*method)(const Param&))
     {
-        m_bindMap[messageName] = [obj,method](WKTypeRef msgBody) {
+        m_bindMap[StringPool::intern(messageName)] = [obj,method](WKTypeRef msgBody) {
             (obj->*method)(fromWK<Param>(msgBody));
         };
     }
@@ -73,7 +82,7 @@ public:
     template<typename Return, typename Obj>
     void bind(const char* messageName, Obj* obj, Return (Obj::*method)())
     {
-        m_bindMap[messageName] = [obj,method](WKTypeRef msgBody) {
+        m_bindMap[StringPool::intern(messageName)] = [obj,method](WKTypeRef msgBody) {
             (obj->*method)();
         };
     }
@@ -81,7 +90,7 @@ public:
     template<typename Obj, typename ObjReceiver, typename Param>
     void bindToDispatcher(const char* messageName, Obj* obj, void (ObjReceiver::*method)(const Param&))
     {
-        m_bindMap[messageName] = [obj,method](WKTypeRef msgBody) {
+        m_bindMap[StringPool::intern(messageName)] = [obj,method](WKTypeRef msgBody) {
             (obj->dispatchMessage)(fromWK<Param>(msgBody), method);
         };
     }
@@ -89,15 +98,16 @@ public:
     template<typename Obj, typename ObjReceiver>
     void bindToDispatcher(const char* messageName, Obj* obj, void (ObjReceiver::*method)())
     {
-        m_bindMap[messageName] = [obj,method](WKTypeRef msgBody) {
+        m_bindMap[StringPool::intern(messageName)] = [obj,method](WKTypeRef msgBody) {
             (obj->dispatchMessage)(method);
         };
     }
 
-    void call(const std::string& messageName, WKTypeRef param) const;
+    void call(StringView messageName, WKTypeRef param) const;
 
 private:
-    typedef std::unordered_map<std::string, std::function<void(WKTypeRef)> > BindMap;
+    // Keyed by interned message names, so dispatching doesn't need to allocate.
+    typedef std::unordered_map<const char*, std::function<void(WKTypeRef)> > BindMap;
     BindMap m_bindMap;
 };
 
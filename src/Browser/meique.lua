@@ -3,14 +3,24 @@ browser:usePackage(glib)
 browser:usePackage(openGL)
 browser:usePackage(x11)
 browser:usePackage(nix)
+browser:usePackage(gstreamer)
+browser:usePackage(gstreamerApp)
+browser:usePackage(gstreamerAudio)
 
 browser:addFiles([[
   main.cpp
+  AudioMixer.cpp
   Browser.cpp
   DesktopWindow.cpp
   InjectedBundleGlue.cpp
   Tab.cpp
 
+  ../Shared/AudioHardware.cpp
+  ../Shared/AudioMixerProtocol.cpp
+  ../Shared/AudioRingBuffer.cpp
+  ../Shared/IPCTracer.cpp
+  ../Shared/StringPool.cpp
+  ../Shared/VectorMath.cpp
   ../Shared/WKConversions.cpp
 ]])
 
@@ -10,9 +10,9 @@ public:
     PlatformClient();
 
     // Audio --------------------------------------------------------------
-    virtual float audioHardwareSampleRate() { return 44100; }
-    virtual size_t audioHardwareBufferSize() { return 128; }
-    virtual unsigned audioHardwareOutputChannels() { return 2; }
+    virtual float audioHardwareSampleRate();
+    virtual size_t audioHardwareBufferSize();
+    virtual unsigned audioHardwareOutputChannels();
 
     // Creates a device for audio I/O.
     // Pass in (numberOfInputChannels > 0) if live/local audio input is desired.
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioConfig.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static bool readBool(const char* name, bool defaultValue)
+{
+    const char* value = getenv(name);
+    if (!value || !*value)
+        return defaultValue;
+    return strcmp(value, "0") && strcmp(value, "false") && strcmp(value, "no");
+}
+
+static std::string readString(const char* name)
+{
+    const char* value = getenv(name);
+    return value ? value : "";
+}
+
+static int readInt(const char* name, int defaultValue)
+{
+    const char* value = getenv(name);
+    if (!value || !*value)
+        return defaultValue;
+    return atoi(value);
+}
+
+static AudioConfig::PrebufferProfile readPrebufferProfile(const std::string& value)
+{
+    if (value.empty() || value == "low-latency")
+        return AudioConfig::LowLatency;
+    if (value == "glitch-resistant")
+        return AudioConfig::GlitchResistant;
+    if (value == "direct" || value == "0")
+        return AudioConfig::Direct;
+    return AudioConfig::CustomPrebuffer;
+}
+
+static AudioConfig::Output readOutput(const std::string& value)
+{
+    if (value == "null")
+        return AudioConfig::NullOutput;
+    if (!value.compare(0, 5, "file:") && value.size() > 5)
+        return AudioConfig::FileOutput;
+    return AudioConfig::DeviceOutput;
+}
+
+static AudioConfig::FFTBackend readFFTBackend(const std::string& value)
+{
+    if (value == "gstreamer")
+        return AudioConfig::GStreamerFFT;
+    if (value == "split")
+        return AudioConfig::SplitFFT;
+#if DEFAULT_FFT_BACKEND_GSTREAMER
+    return AudioConfig::GStreamerFFT;
+#else
+    return AudioConfig::SplitFFT;
+#endif
+}
+
+static Resampler::Quality readResamplerQuality(const std::string& value)
+{
+    if (value == "fast")
+        return Resampler::Fast;
+    if (value == "best")
+        return Resampler::Best;
+    return Resampler::Balanced;
+}
+
+const AudioConfig& AudioConfig::get()
+{
+    static AudioConfig config;
+    return config;
+}
+
+AudioConfig::AudioConfig()
+    : wavRoundTrip(readBool("DROWSER_AUDIO_WAV_ROUNDTRIP", false))
+    , realtime(readBool("DROWSER_AUDIO_RT", true))
+    , realtimePriority(readInt("DROWSER_AUDIO_RT_PRIORITY", 10))
+    , flushDenormals(readBool("DROWSER_AUDIO_FTZ", true))
+    , lockMemory(readBool("DROWSER_AUDIO_MLOCK", true))
+    , cpu(readInt("DROWSER_AUDIO_CPU", -1))
+    , prebufferProfile(readPrebufferProfile(readString("DROWSER_AUDIO_PREBUFFER")))
+    , customPrebufferFrames(prebufferProfile == CustomPrebuffer ? readInt("DROWSER_AUDIO_PREBUFFER", 0) : 0)
+    , output(readOutput(readString("DROWSER_AUDIO_OUTPUT")))
+    , outputPath(output == FileOutput ? readString("DROWSER_AUDIO_OUTPUT").substr(5) : std::string())
+    , suspendAfter(std::max(readInt("DROWSER_AUDIO_SUSPEND_AFTER", 10), 0))
+    , testInput(readString("DROWSER_AUDIO_INPUT") == "test")
+    , statsInterval(readInt("DROWSER_AUDIO_STATS_INTERVAL", 0))
+    , fftBackend(readFFTBackend(readString("DROWSER_AUDIO_FFT")))
+    , wavDecoder(readBool("DROWSER_AUDIO_WAV_DECODER", true))
+    , resamplerQuality(readResamplerQuality(readString("DROWSER_AUDIO_RESAMPLER")))
+    , decodeCacheDirectory(readString("DROWSER_AUDIO_CACHE_DIR"))
+    , decodeCacheSize(std::max(readInt("DROWSER_AUDIO_CACHE_SIZE", 256), 0))
+{
+}
+
+unsigned AudioConfig::prebufferFrames(unsigned quantumFrames, double sampleRate) const
+{
+    switch (prebufferProfile) {
+    case Direct:
+        return 0;
+    case LowLatency:
+        // Absorbs a render spike of one quantum.
+        return 2 * quantumFrames;
+    case GlitchResistant:
+        // Rides out page activity stalling the render thread for a while, at the cost of latency.
+        return std::max(8 * quantumFrames, static_cast<unsigned>(sampleRate * 0.04));
+    case CustomPrebuffer:
+        return customPrebufferFrames;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioConfig_h
+#define AudioConfig_h
+
+#include "Resampler.h"
+#include <string>
+
+// Tuning and debugging knobs of the audio backend. They are read from the
+// environment the first time they're needed, see the README for the list.
+struct AudioConfig {
+    static const AudioConfig& get();
+
+    // Encode the rendered audio as WAV and parse it back before playing it, like
+    // the pipeline used to do. Only useful to compare against the raw pipeline.
+    bool wavRoundTrip;
+
+    // How the render thread is set up, see AudioThread.
+    bool realtime;
+    int realtimePriority;
+    bool flushDenormals;
+    bool lockMemory;
+    int cpu; // -1 doesn't pin the thread.
+
+    // How far ahead of the sink WebCore renders, see prebufferFrames().
+    enum PrebufferProfile {
+        Direct, // Render from the streaming thread, right before pushing.
+        LowLatency,
+        GlitchResistant,
+        CustomPrebuffer
+    };
+    PrebufferProfile prebufferProfile;
+    unsigned customPrebufferFrames;
+
+    // Number of frames to render ahead for the given quantum size and rate, 0 when rendering directly.
+    unsigned prebufferFrames(unsigned quantumFrames, double sampleRate) const;
+
+    // Where AudioDestination sends what it renders. Anything but the device
+    // renders as fast as the CPU allows, see AudioDestination::buildOfflineSinkBranch().
+    enum Output {
+        DeviceOutput,
+        NullOutput,
+        FileOutput // A WAV file at outputPath.
+    };
+    Output output;
+    std::string outputPath;
+
+    // Seconds of digital silence after which a destination pauses its sink, zero
+    // never does, see AudioDestination::handleMessage().
+    unsigned suspendAfter;
+
+    // Feed the live input from audiotestsrc instead of the default capture device.
+    bool testInput;
+
+    // Seconds between render timing reports, zero means no reports.
+    unsigned statsInterval;
+
+    // Which FFT implementation backs the FFT frames WebCore creates.
+    enum FFTBackend {
+        SplitFFT, // RealFFT, for power of two sizes, GStreamer for the others.
+        GStreamerFFT
+    };
+    FFTBackend fftBackend;
+
+    // Decode plain WAV files in-tree, see WavDecoder. Off, they go through the
+    // GStreamer pipeline like other files, only useful to compare the two.
+    bool wavDecoder;
+
+    // Filter length of the in-tree resampler, see Resampler.
+    Resampler::Quality resamplerQuality;
+
+    // Where DecodedAudioCache keeps decoded files, empty for the default, and
+    // how many megabytes it may take. Zero disables it.
+    std::string decodeCacheDirectory;
+    unsigned decodeCacheSize;
+
+private:
+    AudioConfig();
+};
+
+#endif
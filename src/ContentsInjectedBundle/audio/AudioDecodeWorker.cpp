@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioDecodeWorker.h"
+#include "AudioFileReader.h"
+
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#ifdef GST_API_VERSION_1
+#include <gst/audio/audio.h>
+#endif
+
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Decodes only overlap for a few pages at once, more pipelines than this are
+// torn down when they finish.
+static const size_t maximumIdlePipelines = 2;
+
+struct AudioDecodeWorker::Job {
+    AudioFileReader* reader;
+    const void* data;
+    size_t dataSize;
+    float sampleRate;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool done;
+    bool success;
+};
+
+static GstCaps* getGStreamerAudioCaps(int channels, float sampleRate)
+{
+#ifdef GST_API_VERSION_1
+    return gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
+        "channels", G_TYPE_INT, channels,
+        "format", G_TYPE_STRING, gst_audio_format_to_string(GST_AUDIO_FORMAT_F32),
+        "layout", G_TYPE_STRING, "interleaved", NULL);
+#else
+    return gst_caps_new_simple("audio/x-raw-float", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
+        "channels", G_TYPE_INT, channels,
+        "endianness", G_TYPE_INT, G_BYTE_ORDER,
+        "width", G_TYPE_INT, 32, NULL);
+#endif
+}
+
+static std::mutex factoryMutex;
+// Everything decodebin could plug, best ranked first, and the part of it that
+// takes each media type met so far. Never freed, the registry doesn't change
+// under a running web process.
+static GList* decodableFactories;
+static std::map<std::string, GList*> factoriesByMediaType;
+
+static GList* candidateFactories(GstCaps* caps)
+{
+    std::lock_guard<std::mutex> lock(factoryMutex);
+    if (!decodableFactories) {
+        decodableFactories = gst_element_factory_list_get_elements(GST_ELEMENT_FACTORY_TYPE_DECODABLE, GST_RANK_MARGINAL);
+        decodableFactories = g_list_sort(decodableFactories, gst_plugin_feature_rank_compare_func);
+    }
+
+    if (gst_caps_is_any(caps) || gst_caps_is_empty(caps))
+        return decodableFactories;
+
+    const char* mediaType = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    GList*& candidates = factoriesByMediaType[mediaType];
+    if (!candidates) {
+        GstCaps* mediaTypeCaps = gst_caps_new_simple(mediaType, NULL);
+        candidates = gst_element_factory_list_filter(decodableFactories, mediaTypeCaps, GST_PAD_SINK, FALSE);
+        gst_caps_unref(mediaTypeCaps);
+    }
+    return candidates;
+}
+
+// A giostreamsrc ! decodebin ! audioconvert ! audioresample ! capsfilter ! appsink
+// pipeline, only the decodebin part being rebuilt for each file.
+class AudioDecodeWorker::Pipeline {
+public:
+    explicit Pipeline(AudioDecodeWorker*);
+    ~Pipeline();
+
+    void start(Job*);
+    // Back to READY, done with the current job.
+    void reset();
+
+    Job* job() const { return m_job; }
+
+private:
+    static GstFlowReturn newBufferCallback(GstAppSink*, gpointer);
+    static void padAddedCallback(GstElement*, GstPad*, gpointer);
+    static GValueArray* autoplugFactoriesCallback(GstElement*, GstPad*, GstCaps*, gpointer);
+    static gboolean busCallback(GstBus*, GstMessage*, gpointer);
+
+    GstFlowReturn pullFrames(GstAppSink*);
+    void deliverFrames(const void* data, size_t size);
+    void plugDecoder(GstPad*);
+    void handleMessage(GstMessage*);
+
+    AudioDecodeWorker* m_worker;
+    Job* m_job;
+    bool m_durationQueried;
+    float m_sampleRate;
+
+    GstElement* m_pipeline;
+    GstElement* m_source;
+    GstElement* m_decodebin;
+    GstElement* m_convert;
+    GstElement* m_capsFilter;
+    GSource* m_busWatch;
+};
+
+AudioDecodeWorker::Pipeline::Pipeline(AudioDecodeWorker* worker)
+    : m_worker(worker)
+    , m_job(0)
+    , m_durationQueried(false)
+    , m_sampleRate(0)
+{
+    m_pipeline = gst_pipeline_new(0);
+    m_source = gst_element_factory_make("giostreamsrc", 0);
+#ifdef GST_API_VERSION_1
+    m_decodebin = gst_element_factory_make("decodebin", 0);
+#else
+    m_decodebin = gst_element_factory_make("decodebin2", 0);
+#endif
+    m_convert = gst_element_factory_make("audioconvert", 0);
+    GstElement* resample = gst_element_factory_make("audioresample", 0);
+    m_capsFilter = gst_element_factory_make("capsfilter", 0);
+    GstElement* sink = gst_element_factory_make("appsink", 0);
+
+    GstAppSinkCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+#ifdef GST_API_VERSION_1
+    callbacks.new_sample = newBufferCallback;
+#else
+    callbacks.new_buffer = newBufferCallback;
+#endif
+    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, this, 0);
+    g_object_set(sink, "sync", FALSE, NULL);
+
+    g_signal_connect(m_decodebin, "pad-added", G_CALLBACK(padAddedCallback), this);
+    g_signal_connect(m_decodebin, "autoplug-factories", G_CALLBACK(autoplugFactoriesCallback), this);
+
+    gst_bin_add_many(GST_BIN(m_pipeline), m_source, m_decodebin, m_convert, resample, m_capsFilter, sink, NULL);
+    gst_element_link_pads_full(m_source, "src", m_decodebin, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    gst_element_link_pads_full(m_convert, "src", resample, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    gst_element_link_pads_full(resample, "src", m_capsFilter, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    gst_element_link_pads_full(m_capsFilter, "src", sink, "sink", GST_PAD_LINK_CHECK_NOTHING);
+
+    // Watched from the worker's context, whatever thread is the default one.
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    m_busWatch = gst_bus_create_watch(bus);
+    g_source_set_callback(m_busWatch, reinterpret_cast<GSourceFunc>(busCallback), this, 0);
+    g_source_attach(m_busWatch, worker->m_context);
+    gst_object_unref(bus);
+
+    gst_element_set_state(m_pipeline, GST_STATE_READY);
+}
+
+AudioDecodeWorker::Pipeline::~Pipeline()
+{
+    g_source_destroy(m_busWatch);
+    g_source_unref(m_busWatch);
+    gst_element_set_state(m_pipeline, GST_STATE_NULL);
+    gst_object_unref(m_pipeline);
+}
+
+void AudioDecodeWorker::Pipeline::start(Job* job)
+{
+    m_job = job;
+    m_durationQueried = false;
+
+    if (job->sampleRate != m_sampleRate) {
+        m_sampleRate = job->sampleRate;
+        GstCaps* caps = getGStreamerAudioCaps(AudioFileReader::channels, m_sampleRate);
+        g_object_set(m_capsFilter, "caps", caps, NULL);
+        gst_caps_unref(caps);
+    }
+
+    GInputStream* stream = g_memory_input_stream_new_from_data(job->data, job->dataSize, 0);
+    g_object_set(m_source, "stream", stream, NULL);
+    g_object_unref(stream);
+
+    // The converters are plugged as soon as decodebin finds the stream,
+    // nothing to wait for before letting data flow.
+    gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
+}
+
+void AudioDecodeWorker::Pipeline::reset()
+{
+    // Stops the streaming threads, and decodebin drops what it plugged.
+    gst_element_set_state(m_pipeline, GST_STATE_READY);
+
+    GstPad* sinkPad = gst_element_get_static_pad(m_convert, "sink");
+    if (GstPad* peer = gst_pad_get_peer(sinkPad)) {
+        gst_pad_unlink(peer, sinkPad);
+        gst_object_unref(peer);
+    }
+    gst_object_unref(sinkPad);
+
+    // The stream points into the job's data, which goes away with the job.
+    g_object_set(m_source, "stream", NULL, NULL);
+
+    // Anything still queued is about the job that just ended.
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    gst_bus_set_flushing(bus, TRUE);
+    gst_bus_set_flushing(bus, FALSE);
+    gst_object_unref(bus);
+
+    m_job = 0;
+}
+
+GstFlowReturn AudioDecodeWorker::Pipeline::newBufferCallback(GstAppSink* sink, gpointer userData)
+{
+    return static_cast<Pipeline*>(userData)->pullFrames(sink);
+}
+
+void AudioDecodeWorker::Pipeline::padAddedCallback(GstElement*, GstPad* pad, gpointer userData)
+{
+    static_cast<Pipeline*>(userData)->plugDecoder(pad);
+}
+
+GValueArray* AudioDecodeWorker::Pipeline::autoplugFactoriesCallback(GstElement*, GstPad*, GstCaps* caps, gpointer)
+{
+    // What decodebin does by default, but against the cached list for the
+    // media type instead of every decodable factory of the registry.
+    GList* factories = gst_element_factory_list_filter(candidateFactories(caps), caps, GST_PAD_SINK, gst_caps_is_fixed(caps));
+    GValueArray* result = g_value_array_new(g_list_length(factories));
+    for (GList* factory = factories; factory; factory = factory->next) {
+        GValue value;
+        memset(&value, 0, sizeof(value));
+        g_value_init(&value, G_TYPE_OBJECT);
+        g_value_set_object(&value, factory->data);
+        g_value_array_append(result, &value);
+        g_value_unset(&value);
+    }
+    gst_plugin_feature_list_free(factories);
+    return result;
+}
+
+gboolean AudioDecodeWorker::Pipeline::busCallback(GstBus*, GstMessage* message, gpointer userData)
+{
+    // May delete the pipeline, don't touch it afterwards.
+    static_cast<Pipeline*>(userData)->handleMessage(message);
+    return TRUE;
+}
+
+void AudioDecodeWorker::Pipeline::plugDecoder(GstPad* pad)
+{
+    // Only the first audio stream is decoded.
+    GstPad* sinkPad = gst_element_get_static_pad(m_convert, "sink");
+    if (!gst_pad_is_linked(sinkPad))
+        gst_pad_link(pad, sinkPad);
+    gst_object_unref(sinkPad);
+}
+
+void AudioDecodeWorker::Pipeline::deliverFrames(const void* data, size_t size)
+{
+    // Runs on the streaming thread, the job is waiting for EOS meanwhile.
+    AudioFileReader* reader = m_job->reader;
+    if (!m_durationQueried) {
+        m_durationQueried = true;
+        gint64 duration = 0;
+        GstFormat format = GST_FORMAT_TIME;
+#ifdef GST_API_VERSION_1
+        bool known = gst_element_query_duration(m_pipeline, format, &duration);
+#else
+        bool known = gst_element_query_duration(m_pipeline, &format, &duration);
+#endif
+        if (known && duration > 0)
+            reader->expectFrames(gst_util_uint64_scale(duration, static_cast<guint64>(m_sampleRate), GST_SECOND));
+    }
+
+    // The capsfilter only lets interleaved stereo floats through.
+    reader->appendFrames(static_cast<const float*>(data), size / (AudioFileReader::channels * sizeof(float)));
+}
+
+#ifdef GST_API_VERSION_1
+GstFlowReturn AudioDecodeWorker::Pipeline::pullFrames(GstAppSink* sink)
+{
+    GstSample* sample = gst_app_sink_pull_sample(sink);
+    if (!sample)
+        return GST_FLOW_ERROR;
+
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstMapInfo info;
+    if (!buffer || !gst_buffer_map(buffer, &info, GST_MAP_READ)) {
+        gst_sample_unref(sample);
+        return GST_FLOW_ERROR;
+    }
+    deliverFrames(info.data, info.size);
+    gst_buffer_unmap(buffer, &info);
+
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+#else
+GstFlowReturn AudioDecodeWorker::Pipeline::pullFrames(GstAppSink* sink)
+{
+    GstBuffer* buffer = gst_app_sink_pull_buffer(sink);
+    if (!buffer)
+        return GST_FLOW_ERROR;
+
+    deliverFrames(GST_BUFFER_DATA(buffer), GST_BUFFER_SIZE(buffer));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_OK;
+}
+#endif
+
+static void printGstMessage(GstMessage* msg, bool isError = false)
+{
+    GError* error = nullptr;
+    gchar* debug = nullptr;
+
+    if (isError)
+        gst_message_parse_error(msg, &error, &debug);
+    else
+        gst_message_parse_warning(msg, &error, &debug);
+
+    g_printerr("%s from element %s: %s\n", (isError) ? "ERROR" : "WARNING", GST_OBJECT_NAME(msg->src), error->message);
+    g_printerr("Debugging info: %s\n", (debug) ? debug : "none");
+
+    g_error_free(error);
+    g_free(debug);
+}
+
+void AudioDecodeWorker::Pipeline::handleMessage(GstMessage* message)
+{
+    if (!m_job)
+        return;
+
+    switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_EOS:
+        m_worker->finishJob(this, true);
+        break;
+    case GST_MESSAGE_WARNING:
+        printGstMessage(message);
+        break;
+    case GST_MESSAGE_ERROR:
+        printGstMessage(message, true);
+        m_worker->finishJob(this, false);
+        break;
+    default:
+        break;
+    }
+}
+
+AudioDecodeWorker& AudioDecodeWorker::get()
+{
+    // Never destroyed, the thread runs until the process exits.
+    static AudioDecodeWorker* worker = new AudioDecodeWorker;
+    return *worker;
+}
+
+AudioDecodeWorker::AudioDecodeWorker()
+    : m_context(g_main_context_new())
+    , m_loop(g_main_loop_new(m_context, FALSE))
+{
+    m_thread = std::thread(&AudioDecodeWorker::run, this);
+}
+
+void AudioDecodeWorker::run()
+{
+    g_main_context_push_thread_default(m_context);
+    g_main_loop_run(m_loop);
+}
+
+bool AudioDecodeWorker::decode(AudioFileReader* reader, const void* data, size_t dataSize, float sampleRate)
+{
+    Job job;
+    job.reader = reader;
+    job.data = data;
+    job.dataSize = dataSize;
+    job.sampleRate = sampleRate;
+    job.done = false;
+    job.success = false;
+
+    GSource* source = g_idle_source_new();
+    g_source_set_callback(source, startJob, &job, 0);
+    g_source_attach(source, m_context);
+    g_source_unref(source);
+
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.condition.wait(lock, [&job] { return job.done; });
+    return job.success;
+}
+
+gboolean AudioDecodeWorker::startJob(gpointer userData)
+{
+    AudioDecodeWorker& worker = get();
+    Pipeline* pipeline;
+    if (worker.m_idlePipelines.empty())
+        pipeline = new Pipeline(&worker);
+    else {
+        pipeline = worker.m_idlePipelines.back();
+        worker.m_idlePipelines.pop_back();
+    }
+
+    pipeline->start(static_cast<Job*>(userData));
+    return FALSE;
+}
+
+void AudioDecodeWorker::finishJob(Pipeline* pipeline, bool success)
+{
+    Job* job = pipeline->job();
+    pipeline->reset();
+
+    // A pipeline that failed may be stuck halfway, better start afresh.
+    if (success && m_idlePipelines.size() < maximumIdlePipelines)
+        m_idlePipelines.push_back(pipeline);
+    else
+        delete pipeline;
+
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->success = success;
+    job->done = true;
+    job->condition.notify_one();
+}
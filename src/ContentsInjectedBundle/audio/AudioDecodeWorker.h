@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioDecodeWorker_h
+#define AudioDecodeWorker_h
+
+#include <glib.h>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+class AudioFileReader;
+
+// The thread every AudioFileReader of the process decodes on. It owns the one
+// GMainContext the pipelines' buses are watched from, and keeps the pipelines
+// of finished decodes in READY for the next ones, so a decode only costs
+// setting the input and going to PLAYING. The factories decodebin picks from
+// are looked up once per media type and shared by all pipelines.
+class AudioDecodeWorker {
+public:
+    static AudioDecodeWorker& get();
+
+    // Decodes data to interleaved stereo floats at sampleRate, handing them to
+    // reader from the streaming thread. Blocks until the end of the stream,
+    // returns false if decoding failed. Thread safe.
+    bool decode(AudioFileReader*, const void* data, size_t dataSize, float sampleRate);
+
+private:
+    class Pipeline;
+    struct Job;
+
+    AudioDecodeWorker();
+    void run();
+
+    static gboolean startJob(gpointer);
+    void finishJob(Pipeline*, bool success);
+
+    GMainContext* m_context;
+    GMainLoop* m_loop;
+    std::thread m_thread;
+    // Only touched from the worker thread.
+    std::vector<Pipeline*> m_idlePipelines;
+};
+
+#endif
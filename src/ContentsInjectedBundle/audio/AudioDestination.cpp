@@ -17,68 +17,296 @@
  */
 
 #include "AudioDestination.h"
+#include "AudioConfig.h"
+#include "AudioRingBuffer.h"
 #include "WebKitWebAudioSourceGStreamer.h"
 
+#include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 #include <gst/pbutils/pbutils.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef GST_API_VERSION_1
+#include <gst/audio/audio.h>
+#endif
 
 using namespace Nix;
 
+GST_DEBUG_CATEGORY_STATIC(webkit_audio_destination_debug);
+#define GST_CAT_DEFAULT webkit_audio_destination_debug
+
 #ifndef GST_API_VERSION_1
 static void onGStreamerWavparsePadAddedCallback(GstElement* element, GstPad* pad, AudioDestination* destination)
 {
-    destination->finishBuildingPipelineAfterWavParserPadReady(pad);
+    destination->linkWavParserPad(pad);
 }
 #endif
 
+#ifdef GST_API_VERSION_1
+static GstFlowReturn onCaptureSampleCallback(GstAppSink* sink, AudioDestination* destination)
+{
+    GstSample* sample = gst_app_sink_pull_sample(sink);
+    if (!sample)
+        return GST_FLOW_OK;
+    destination->captureBuffer(gst_sample_get_buffer(sample));
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+#else
+static GstFlowReturn onCaptureBufferCallback(GstAppSink* sink, AudioDestination* destination)
+{
+    GstBuffer* buffer = gst_app_sink_pull_buffer(sink);
+    if (!buffer)
+        return GST_FLOW_OK;
+    destination->captureBuffer(buffer);
+    gst_buffer_unref(buffer);
+    return GST_FLOW_OK;
+}
+#endif
+
+static gboolean messageCallback(GstBus*, GstMessage* message, AudioDestination* destination)
+{
+    return destination->handleMessage(message);
+}
+
+static uint32_t littleEndian32(const unsigned char* bytes)
+{
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+static void storeLittleEndian32(unsigned char* bytes, uint32_t value)
+{
+    for (unsigned i = 0; i < 4; ++i)
+        bytes[i] = value >> (8 * i);
+}
+
+// wavenc only writes the real sizes in the header on EOS, which the stream
+// never reaches, it's torn down with the page. Fill them in from the file size.
+static void finishWavFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat status;
+    unsigned char header[12];
+    if (fstat(fd, &status) || status.st_size > 0xffffffffLL || pread(fd, header, sizeof(header), 0) != sizeof(header) || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)) {
+        close(fd);
+        return;
+    }
+
+    off_t offset = sizeof(header);
+    unsigned char chunk[8];
+    while (offset + 8 <= status.st_size && pread(fd, chunk, sizeof(chunk), offset) == sizeof(chunk)) {
+        if (!memcmp(chunk, "data", 4)) {
+            storeLittleEndian32(chunk + 4, status.st_size - offset - 8);
+            storeLittleEndian32(header + 4, status.st_size - 8);
+            if (pwrite(fd, chunk, sizeof(chunk), offset) != sizeof(chunk) || pwrite(fd, header, 8, 0) != 8)
+                GST_WARNING("Can't fix up the header of %s", path.c_str());
+            break;
+        }
+        uint32_t size = littleEndian32(chunk + 4);
+        offset += 8 + size + (size & 1);
+    }
+    close(fd);
+}
+
+// Rendering offline is about throughput, silence is never suspended there.
+static unsigned suspendAfterFrames(double sampleRate)
+{
+    if (AudioConfig::get().output != AudioConfig::DeviceOutput)
+        return 0;
+    return std::min<double>(AudioConfig::get().suspendAfter * sampleRate, G_MAXUINT);
+}
+
 AudioDestination::AudioDestination(size_t bufferSize, unsigned numberOfInputChannels, unsigned numberOfChannels, double sampleRate, AudioDevice::RenderCallback* callback)
-    : m_wavParserAvailable(false)
-    , m_audioSinkAvailable(false)
+    : m_audioSinkAvailable(false)
     , m_pipeline(0)
+    , m_source(0)
+    , m_audioConvert(0)
+    , m_busWatch(0)
+    , m_statsTimer(0)
+    , m_capturePipeline(0)
+    , m_captureBusWatch(0)
+    , m_input(0)
     , m_sampleRate(sampleRate)
+    , m_bufferSize(bufferSize)
+    , m_playingSince(0)
+    , m_playingTime(0)
+    , m_started(false)
+    , m_silent(false)
 {
-    // FIXME: NUMBER OF CHANNELS NOT USED??????????/ WHY??????????
+    if (!webkit_audio_destination_debug)
+        GST_DEBUG_CATEGORY_INIT(webkit_audio_destination_debug, "webkitaudiodestination", 0, "WebAudio destination");
+
     m_pipeline = gst_pipeline_new("play");
 
-    GstElement* webkitAudioSrc = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
-                                                                            "rate", sampleRate,
-                                                                            "handler", callback,
-                                                                            "frames", bufferSize, NULL));
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
+    m_busWatch = gst_bus_add_watch(bus, reinterpret_cast<GstBusFunc>(messageCallback), this);
+    gst_object_unref(bus);
 
-    GstElement* wavParser = gst_element_factory_make("wavparse", 0);
+    // The source positions up to 7.1, WebCore doesn't create larger destinations anyway.
+    if (numberOfChannels > 8) {
+        GST_WARNING("Can't render %u channels, rendering 8", numberOfChannels);
+        numberOfChannels = 8;
+    }
+
+    if (numberOfInputChannels)
+        buildCapturePipeline(numberOfInputChannels);
+
+    // The source refuses larger values, and would then render directly.
+    unsigned prebuffer = AudioConfig::get().prebufferFrames(bufferSize, sampleRate);
+    if (prebuffer > G_MAXUINT16) {
+        GST_WARNING("Can't prebuffer %u frames, prebuffering %u", prebuffer, G_MAXUINT16);
+        prebuffer = G_MAXUINT16;
+    }
+
+    m_source = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
+                                                          "rate", sampleRate,
+                                                          "handler", callback,
+                                                          "frames", static_cast<guint>(bufferSize),
+                                                          "channels", numberOfChannels,
+                                                          "input", m_input,
+                                                          "prebuffer", prebuffer,
+                                                          "suspend-after", suspendAfterFrames(sampleRate), NULL));
+    gst_bin_add(GST_BIN(m_pipeline), m_source);
 
-    m_wavParserAvailable = wavParser;
+    if (unsigned interval = AudioConfig::get().statsInterval) {
+        m_statsTimer = g_timeout_add_seconds(interval, [](gpointer data) -> gboolean {
+            static_cast<AudioDestination*>(data)->printRenderStats();
+            return TRUE;
+        }, this);
+    }
 
-    //ASSERT_WITH_MESSAGE(m_wavParserAvailable, "Failed to create GStreamer wavparse element");
-    if (!m_wavParserAvailable)
+    if (!buildSinkBranch())
         return;
 
-#ifndef GST_API_VERSION_1
-    g_signal_connect(wavParser, "pad-added", G_CALLBACK(onGStreamerWavparsePadAddedCallback), this);
-#endif
-    gst_bin_add_many(GST_BIN(m_pipeline), webkitAudioSrc, wavParser, NULL);
-    gst_element_link_pads_full(webkitAudioSrc, "src", wavParser, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    // The source produces raw interleaved float samples, which go straight to the sink.
+    // The WAV round trip is only kept around to measure what we saved by dropping it.
+    if (AudioConfig::get().wavRoundTrip && buildWavRoundTrip(m_source))
+        return;
 
-#ifdef GST_API_VERSION_1
-    GstPad* srcPad = gst_element_get_static_pad(wavParser, "src");
-    finishBuildingPipelineAfterWavParserPadReady(srcPad);
-#endif
+    gst_element_link_pads_full(m_source, "src", m_audioConvert, "sink", GST_PAD_LINK_CHECK_NOTHING);
 }
 
 AudioDestination::~AudioDestination()
 {
+    if (AudioConfig::get().output != AudioConfig::DeviceOutput && m_audioSinkAvailable)
+        printOfflineThroughput();
+
+    if (m_busWatch)
+        g_source_remove(m_busWatch);
+    if (m_statsTimer)
+        g_source_remove(m_statsTimer);
     gst_element_set_state(m_pipeline, GST_STATE_NULL);
     gst_object_unref(m_pipeline);
+
+    if (m_captureBusWatch)
+        g_source_remove(m_captureBusWatch);
+    if (m_capturePipeline) {
+        gst_element_set_state(m_capturePipeline, GST_STATE_NULL);
+        gst_object_unref(m_capturePipeline);
+    }
+    // Both pipelines are down, nobody reads or writes the ring anymore.
+    delete m_input;
+
+    if (!m_outputPath.empty())
+        finishWavFile(m_outputPath);
 }
 
-void AudioDestination::finishBuildingPipelineAfterWavParserPadReady(GstPad* pad)
+// Live input runs in a pipeline of its own, so the playback pipeline doesn't become live.
+// Captured samples are converted to what WebCore wants and written to m_input from the
+// appsink streaming thread, the render loop reads them from there without locking.
+void AudioDestination::buildCapturePipeline(unsigned numberOfInputChannels)
 {
-    //FIXME: POSSIBLE LEAK!!!
+    GstElement* captureSource;
+    if (AudioConfig::get().testInput) {
+        captureSource = gst_element_factory_make("audiotestsrc", 0);
+        if (captureSource)
+            g_object_set(captureSource, "is-live", TRUE, "samplesperbuffer", static_cast<int>(m_sampleRate / 100), NULL);
+    } else
+        captureSource = gst_element_factory_make("autoaudiosrc", 0);
+
+    GstElement* audioConvert = gst_element_factory_make("audioconvert", 0);
+    GstElement* audioResample = gst_element_factory_make("audioresample", 0);
+    GstElement* captureSink = gst_element_factory_make("appsink", 0);
+    if (!captureSource || !audioConvert || !audioResample || !captureSink) {
+        GST_WARNING("Can't build the capture pipeline, the live input will be silent");
+        GstElement* elements[] = { captureSource, audioConvert, audioResample, captureSink };
+        for (GstElement* element : elements) {
+            if (element)
+                gst_object_unref(element);
+        }
+        return;
+    }
+
+    // About 200ms of input, trimmed down when more than 50ms pile up.
+    size_t rate = static_cast<size_t>(m_sampleRate);
+    m_input = new AudioRingBuffer(numberOfInputChannels, rate / 5, rate / 20);
+
+#ifdef GST_API_VERSION_1
+    GstCaps* caps = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, GST_AUDIO_NE(F32),
+                                        "layout", G_TYPE_STRING, "interleaved",
+                                        "rate", G_TYPE_INT, static_cast<int>(m_sampleRate),
+                                        "channels", G_TYPE_INT, m_input->channels(), NULL);
+#else
+    GstCaps* caps = gst_caps_new_simple("audio/x-raw-float", "width", G_TYPE_INT, 32,
+                                        "endianness", G_TYPE_INT, G_BYTE_ORDER,
+                                        "rate", G_TYPE_INT, static_cast<int>(m_sampleRate),
+                                        "channels", G_TYPE_INT, m_input->channels(), NULL);
+#endif
+    gst_app_sink_set_caps(GST_APP_SINK(captureSink), caps);
+    gst_caps_unref(caps);
+
+    GstAppSinkCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+#ifdef GST_API_VERSION_1
+    callbacks.new_sample = reinterpret_cast<GstFlowReturn (*)(GstAppSink*, gpointer)>(onCaptureSampleCallback);
+#else
+    callbacks.new_buffer = reinterpret_cast<GstFlowReturn (*)(GstAppSink*, gpointer)>(onCaptureBufferCallback);
+#endif
+    gst_app_sink_set_callbacks(GST_APP_SINK(captureSink), &callbacks, this, 0);
+    g_object_set(captureSink, "sync", FALSE, NULL);
+
+    m_capturePipeline = gst_pipeline_new("capture");
+    gst_bin_add_many(GST_BIN(m_capturePipeline), captureSource, audioConvert, audioResample, captureSink, NULL);
+    gst_element_link_many(captureSource, audioConvert, audioResample, captureSink, NULL);
+
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_capturePipeline));
+    m_captureBusWatch = gst_bus_add_watch(bus, reinterpret_cast<GstBusFunc>(messageCallback), this);
+    gst_object_unref(bus);
+}
+
+void AudioDestination::captureBuffer(GstBuffer* buffer)
+{
+#ifdef GST_API_VERSION_1
+    GstMapInfo info;
+    if (!gst_buffer_map(buffer, &info, GST_MAP_READ))
+        return;
+    m_input->write(reinterpret_cast<const float*>(info.data), info.size / (m_input->channels() * sizeof(float)));
+    gst_buffer_unmap(buffer, &info);
+#else
+    m_input->write(reinterpret_cast<const float*>(GST_BUFFER_DATA(buffer)), GST_BUFFER_SIZE(buffer) / (m_input->channels() * sizeof(float)));
+#endif
+}
+
+bool AudioDestination::buildSinkBranch()
+{
+    if (AudioConfig::get().output != AudioConfig::DeviceOutput)
+        return buildOfflineSinkBranch();
+
     GstElement* audioSink = gst_element_factory_make("autoaudiosink", 0);
     m_audioSinkAvailable = audioSink;
 
     if (!audioSink)
-        return;
+        return false;
 
     // Autoaudiosink does the real sink detection in the GST_STATE_NULL->READY transition
     // so it's best to roll it to READY as soon as possible to ensure the underlying platform
@@ -86,35 +314,234 @@ void AudioDestination::finishBuildingPipelineAfterWavParserPadReady(GstPad* pad)
     GstStateChangeReturn stateChangeReturn = gst_element_set_state(audioSink, GST_STATE_READY);
     if (stateChangeReturn == GST_STATE_CHANGE_FAILURE) {
         gst_element_set_state(audioSink, GST_STATE_NULL);
+        gst_object_unref(audioSink);
         m_audioSinkAvailable = false;
-        return;
+        return false;
     }
 
-    GstElement* audioConvert = gst_element_factory_make("audioconvert", 0);
-    gst_bin_add_many(GST_BIN(m_pipeline), audioConvert, audioSink, NULL);
+    m_audioConvert = gst_element_factory_make("audioconvert", 0);
+    gst_bin_add_many(GST_BIN(m_pipeline), m_audioConvert, audioSink, NULL);
+    gst_element_link_pads_full(m_audioConvert, "src", audioSink, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    return true;
+}
+
+// Every destination of the process but the first gets a number before the extension.
+static std::string offlineOutputPath()
+{
+    static std::atomic<unsigned> destinations(0);
+    std::string path = AudioConfig::get().outputPath;
+    unsigned number = destinations.fetch_add(1);
+    if (!number)
+        return path;
+
+    size_t extension = path.rfind('.');
+    if (extension == std::string::npos || path.find('/', extension) != std::string::npos)
+        extension = path.size();
+    return path.substr(0, extension) + "-" + std::to_string(number) + path.substr(extension);
+}
+
+// A sink that doesn't sync on the clock, so the source's task renders and pushes
+// as fast as the CPU allows: headless regression runs, and a benchmark of the
+// audio graphs of a page with printOfflineThroughput().
+bool AudioDestination::buildOfflineSinkBranch()
+{
+    bool toFile = AudioConfig::get().output == AudioConfig::FileOutput;
+    GstElement* encoder = toFile ? gst_element_factory_make("wavenc", 0) : 0;
+    GstElement* audioSink = gst_element_factory_make(toFile ? "filesink" : "fakesink", 0);
+    m_audioConvert = gst_element_factory_make("audioconvert", 0);
+    if (!audioSink || !m_audioConvert || (toFile && !encoder)) {
+        GST_WARNING("Can't build the offline sink branch, not rendering");
+        GstElement* elements[] = { encoder, audioSink, m_audioConvert };
+        for (GstElement* element : elements) {
+            if (element)
+                gst_object_unref(element);
+        }
+        m_audioConvert = 0;
+        return false;
+    }
+
+    g_object_set(audioSink, "sync", FALSE, NULL);
+    if (toFile) {
+        m_outputPath = offlineOutputPath();
+        g_object_set(audioSink, "location", m_outputPath.c_str(), NULL);
+    }
+
+    m_audioSinkAvailable = true;
+    gst_bin_add_many(GST_BIN(m_pipeline), m_audioConvert, audioSink, NULL);
+    if (encoder) {
+        gst_bin_add(GST_BIN(m_pipeline), encoder);
+        gst_element_link_pads_full(m_audioConvert, "src", encoder, "sink", GST_PAD_LINK_CHECK_NOTHING);
+        gst_element_link_pads_full(encoder, "src", audioSink, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    } else
+        gst_element_link_pads_full(m_audioConvert, "src", audioSink, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    return true;
+}
+
+bool AudioDestination::buildWavRoundTrip(GstElement* source)
+{
+    GstElement* wavEncoder = gst_element_factory_make("wavenc", 0);
+    GstElement* wavParser = gst_element_factory_make("wavparse", 0);
+    if (!wavEncoder || !wavParser) {
+        GST_WARNING("wavenc or wavparse missing, not doing the WAV round trip");
+        if (wavEncoder)
+            gst_object_unref(wavEncoder);
+        if (wavParser)
+            gst_object_unref(wavParser);
+        return false;
+    }
+
+    gst_bin_add_many(GST_BIN(m_pipeline), wavEncoder, wavParser, NULL);
+    gst_element_link_pads_full(source, "src", wavEncoder, "sink", GST_PAD_LINK_CHECK_NOTHING);
+    gst_element_link_pads_full(wavEncoder, "src", wavParser, "sink", GST_PAD_LINK_CHECK_NOTHING);
+
+#ifdef GST_API_VERSION_1
+    GstPad* srcPad = gst_element_get_static_pad(wavParser, "src");
+    linkWavParserPad(srcPad);
+    gst_object_unref(srcPad);
+#else
+    g_signal_connect(wavParser, "pad-added", G_CALLBACK(onGStreamerWavparsePadAddedCallback), this);
+#endif
+    return true;
+}
 
-    // Link wavparse's src pad to audioconvert sink pad.
-    GstPad* sinkPad = gst_element_get_static_pad(audioConvert, "sink");
+void AudioDestination::linkWavParserPad(GstPad* pad)
+{
+    GstPad* sinkPad = gst_element_get_static_pad(m_audioConvert, "sink");
     gst_pad_link_full(pad, sinkPad, GST_PAD_LINK_CHECK_NOTHING);
+    gst_object_unref(sinkPad);
+}
+
+gboolean AudioDestination::handleMessage(GstMessage* message)
+{
+    // The capture pipeline posts here too. Only what comes from the playback one
+    // goes into the render stats or changes the playback state.
+    bool fromPlayback = gst_object_has_ancestor(GST_MESSAGE_SRC(message), GST_OBJECT(m_pipeline));
+
+    switch (GST_MESSAGE_TYPE(message)) {
+    case GST_MESSAGE_ASYNC_DONE:
+        if (fromPlayback)
+            reportLatency();
+        break;
+    case GST_MESSAGE_QOS:
+        // Sinks post QoS when they drop or render buffers late, which is audible.
+        if (fromPlayback && GST_MESSAGE_SRC(message) != GST_OBJECT(m_source))
+            webkit_web_audio_src_get_render_stats(WEBKIT_WEB_AUDIO_SRC(m_source))->recordSinkQoS();
+        break;
+    case GST_MESSAGE_ELEMENT: {
+        // The source stops pushing while its output is silent. Pausing the pipeline lets
+        // the sink stop the device too, instead of playing silence it's starved of.
+        const GstStructure* structure = gst_message_get_structure(message);
+        gboolean silent;
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(m_source) && gst_structure_has_name(structure, "webkit-web-audio-silence")
+            && gst_structure_get_boolean(structure, "silent", &silent)) {
+            m_silent = silent;
+            updatePipelineState();
+        }
+        break;
+    }
+    case GST_MESSAGE_WARNING: {
+        GError* error = 0;
+        gst_message_parse_warning(message, &error, 0);
+        GST_WARNING("Warning from %s: %s", GST_OBJECT_NAME(GST_MESSAGE_SRC(message)), error->message);
+        g_error_free(error);
+        if (fromPlayback)
+            webkit_web_audio_src_get_render_stats(WEBKIT_WEB_AUDIO_SRC(m_source))->recordSinkWarning();
+        break;
+    }
+    case GST_MESSAGE_ERROR: {
+        GError* error = 0;
+        gst_message_parse_error(message, &error, 0);
+        GST_ERROR("Error from %s: %s", GST_OBJECT_NAME(GST_MESSAGE_SRC(message)), error->message);
+        g_error_free(error);
+        break;
+    }
+    default:
+        break;
+    }
+    return TRUE;
+}
+
+void AudioDestination::reportLatency()
+{
+    GstQuery* query = gst_query_new_latency();
+    if (gst_element_query(m_pipeline, query)) {
+        gboolean live;
+        GstClockTime minLatency, maxLatency;
+        gst_query_parse_latency(query, &live, &minLatency, &maxLatency);
+        GST_INFO("Pipeline latency%s: min %" GST_TIME_FORMAT " max %" GST_TIME_FORMAT,
+                 AudioConfig::get().wavRoundTrip ? " with the WAV round trip" : "",
+                 GST_TIME_ARGS(minLatency), GST_TIME_ARGS(maxLatency));
+    }
+    gst_query_unref(query);
+}
+
+AudioRenderStats::Snapshot AudioDestination::renderStats() const
+{
+    return webkit_web_audio_src_get_render_stats(WEBKIT_WEB_AUDIO_SRC(m_source))->snapshot();
+}
+
+void AudioDestination::printRenderStats() const
+{
+    std::cerr << "[Audio pid " << getpid() << "] ";
+    AudioRenderStats::print(std::cerr, renderStats());
+
+    if (m_input) {
+        AudioRingBuffer::Stats input = m_input->stats();
+        std::cerr << "[Audio pid " << getpid() << "] input latency avg " << input.latencyAverage * 1000 / m_sampleRate
+                  << "ms max " << input.latencyMax * 1000 / m_sampleRate << "ms, overruns " << input.overruns
+                  << " underruns " << input.underruns << " frames" << std::endl;
+    }
 
-    // Link audioconvert to audiosink and roll states.
-    gst_element_link_pads_full(audioConvert, "src", audioSink, "sink", GST_PAD_LINK_CHECK_NOTHING);
-    gst_element_sync_state_with_parent(audioConvert);
-    gst_element_sync_state_with_parent(audioSink); //FIXME: I believe we should delete audioSink after this.
+    if (AudioConfig::get().output != AudioConfig::DeviceOutput)
+        printOfflineThroughput();
+}
+
+void AudioDestination::printOfflineThroughput() const
+{
+    uint64_t frames = renderStats().quanta * m_bufferSize;
+    uint64_t time = m_playingTime;
+    if (m_playingSince)
+        time += AudioRenderStats::now() - m_playingSince;
+    double seconds = time / 1e9;
+    double framesPerSecond = seconds > 0 ? frames / seconds : 0;
+
+    std::cerr << "[Audio pid " << getpid() << "] rendered " << frames << " frames in " << seconds << "s, "
+              << static_cast<uint64_t>(framesPerSecond) << " frames/s, " << framesPerSecond / m_sampleRate
+              << "x real time" << std::endl;
 }
 
 void AudioDestination::start()
 {
-    if (!m_wavParserAvailable)
+    if (!m_audioSinkAvailable)
         return;
 
-    gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
+    m_started = true;
+    updatePipelineState();
+    if (m_capturePipeline)
+        gst_element_set_state(m_capturePipeline, GST_STATE_PLAYING);
+    if (!m_playingSince)
+        m_playingSince = AudioRenderStats::now();
 }
 
 void AudioDestination::stop()
 {
-    if (!m_wavParserAvailable || !m_audioSinkAvailable)
+    if (!m_audioSinkAvailable)
         return;
 
-    gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
+    if (m_capturePipeline)
+        gst_element_set_state(m_capturePipeline, GST_STATE_PAUSED);
+    m_started = false;
+    updatePipelineState();
+    if (m_playingSince) {
+        m_playingTime += AudioRenderStats::now() - m_playingSince;
+        m_playingSince = 0;
+    }
+}
+
+// The source keeps rendering, at a low pace, while its output is suspended, so
+// the capture pipeline is left alone: live input may end the silence.
+void AudioDestination::updatePipelineState()
+{
+    webkit_web_audio_src_set_rendering(WEBKIT_WEB_AUDIO_SRC(m_source), m_started);
+    gst_element_set_state(m_pipeline, m_started && !m_silent ? GST_STATE_PLAYING : GST_STATE_PAUSED);
 }
@@ -1,8 +1,12 @@
 #ifndef AudioDestination_h
 #define AudioDestination_h
 
+#include "AudioRenderStats.h"
 #include <gst/gst.h>
 #include <NixPlatform/Platform.h>
+#include <string>
+
+class AudioRingBuffer;
 
 class AudioDestination : public Nix::AudioDevice {
 public:
@@ -14,13 +18,42 @@ public:
 
     double sampleRate() { return m_sampleRate; }
 
-    void finishBuildingPipelineAfterWavParserPadReady(GstPad*);
+    // Timing of the render loop and what the sink reported so far.
+    AudioRenderStats::Snapshot renderStats() const;
+    void printRenderStats() const;
+    // Only meaningful when not playing to the device, see buildOfflineSinkBranch().
+    void printOfflineThroughput() const;
+
+    void linkWavParserPad(GstPad*);
+    gboolean handleMessage(GstMessage*);
+    void captureBuffer(GstBuffer*);
 
 private:
-    bool m_wavParserAvailable;
+    bool buildSinkBranch();
+    bool buildOfflineSinkBranch();
+    bool buildWavRoundTrip(GstElement* source);
+    void buildCapturePipeline(unsigned numberOfInputChannels);
+    void reportLatency();
+    void updatePipelineState();
+
     bool m_audioSinkAvailable;
     GstElement* m_pipeline;
+    GstElement* m_source;
+    GstElement* m_audioConvert;
+    guint m_busWatch;
+    guint m_statsTimer;
+    GstElement* m_capturePipeline;
+    guint m_captureBusWatch;
+    AudioRingBuffer* m_input;
     double m_sampleRate;
+    size_t m_bufferSize;
+    std::string m_outputPath;
+    // Time spent playing, in nanoseconds, for the offline throughput.
+    uint64_t m_playingSince;
+    uint64_t m_playingTime;
+    // WebCore started us, and the source didn't suspend its output for being silent.
+    bool m_started;
+    bool m_silent;
 };
 
 #endif
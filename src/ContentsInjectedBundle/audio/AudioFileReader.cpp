@@ -18,448 +18,139 @@
  */
 
 #include "AudioFileReader.h"
+#include "AudioConfig.h"
+#include "AudioDecodeWorker.h"
+#include "DecodedAudioCache.h"
 
 #include <NixPlatform/AudioBus.h>
 
-#include <gio/gio.h>
-#include <gst/gst.h>
-#include <gst/app/gstappsink.h>
-#include <gst/pbutils/pbutils.h>
-
-#ifdef GST_API_VERSION_1
-#include <gst/audio/audio.h>
-#else
-#include <gst/audio/multichannel.h>
-#endif
+#include "VectorMath.h"
+#include "WavDecoder.h"
 
 #include <glib.h>
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
 #include <cassert>
+#include <vector>
 
 using namespace Nix;
 
-Data AudioFileReader::loadResource(const char* name)
-{
-    FILE* pFile;
-    long lSize;
-    char* buffer;
-    size_t result;
-
-    pFile = fopen(name, "rb");
-
-    fseek(pFile , 0 , SEEK_END);
-    lSize = ftell(pFile);
-    rewind(pFile);
-
-    buffer = (char*) malloc(sizeof(char) * lSize);
-    result = fread(buffer, sizeof(char), lSize, pFile);
-
-    // terminate
-    fclose(pFile);
-    return Data(buffer, result);
-}
-
-static GstCaps* getGStreamerAudioCaps(int channels, float sampleRate)
-{
-#ifdef GST_API_VERSION_1
-    return gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
-        "channels", G_TYPE_INT, channels,
-        "format", G_TYPE_STRING, gst_audio_format_to_string(GST_AUDIO_FORMAT_F32),
-        "layout", G_TYPE_STRING, "interleaved", NULL);
-#else
-    return gst_caps_new_simple("audio/x-raw-float", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
-        "channels", G_TYPE_INT, channels,
-        "endianness", G_TYPE_INT, G_BYTE_ORDER,
-        "width", G_TYPE_INT, 32, NULL);
-#endif
-}
-
-static void copyGStreamerBuffersToAudioChannel(GstBufferList* buffers, float* destination)
-{
-#ifdef GST_API_VERSION_1
-    unsigned bufferCount = gst_buffer_list_length(buffers);
-    for (unsigned i = 0; i < bufferCount; ++i) {
-        GstBuffer* buffer = gst_buffer_list_get(buffers, i);
-        assert(buffer);
-        gsize bufferSize = gst_buffer_get_size(buffer);
-        gst_buffer_extract(buffer, 0, destination, bufferSize);
-        destination += bufferSize / sizeof(float);
-    }
-#else
-    GstBufferListIterator* iter = gst_buffer_list_iterate(buffers);
-    gst_buffer_list_iterator_next_group(iter);
-    GstBuffer* buffer = gst_buffer_list_iterator_merge_group(iter);
-    if (buffer) {
-        memcpy(destination, reinterpret_cast<float*>(GST_BUFFER_DATA(buffer)), GST_BUFFER_SIZE(buffer));
-        gst_buffer_unref(buffer);
-    }
-    gst_buffer_list_iterator_free(iter);
-#endif
-}
-
-static GstFlowReturn onAppsinkNewBufferCallback(GstAppSink* sink, gpointer userData)
-{
-#ifdef GST_API_VERSION_1
-    return static_cast<AudioFileReader*>(userData)->handleSample(sink);
-#else
-    return static_cast<AudioFileReader*>(userData)->handleBuffer(sink);
-#endif
-}
+// Frames per chunk when decoding ahead of knowing how long the file is.
+static const size_t chunkFrames = 64 * 1024;
 
-gboolean messageCallback(GstBus* bus, GstMessage* message, AudioFileReader* reader)
-{
-    return reader->handleMessage(message);
-}
-
-static void onGStreamerDeinterleavePadAddedCallback(GstElement* element, GstPad* pad, AudioFileReader* reader)
-{
-    reader->handleNewDeinterleavePad(pad);
-}
-
-static void onGStreamerDeinterleaveReadyCallback(GstElement* element, AudioFileReader* reader)
-{
-    reader->deinterleavePadsConfigured();
-}
-
-static void onGStreamerDecodebinPadAddedCallback(GstElement* element, GstPad* pad, AudioFileReader* reader)
-{
-    reader->plugDeinterleave(pad);
-}
-
-gboolean enteredMainLoopCallback(gpointer userData)
-{
-    AudioFileReader* reader = reinterpret_cast<AudioFileReader*>(userData);
-    reader->decodeAudioForBusCreation();
-    return FALSE;
-}
+const unsigned AudioFileReader::channels;
 
 AudioFileReader::AudioFileReader(const void* data, size_t dataSize)
     : m_data(data)
     , m_dataSize(dataSize)
     , m_sampleRate(44100)
-    , m_frontLeftBuffers(0)
-    , m_frontRightBuffers(0)
-#ifndef GST_API_VERSION_1
-    , m_frontLeftBuffersIterator(0)
-    , m_frontRightBuffersIterator(0)
-#endif
-    , m_pipeline(0)
-    , m_channelSize(0)
-    , m_decodebin(0)
-    , m_deInterleave(0)
-    , m_loop(0)
-    , m_errorOccurred(false)
+    , m_bus(0)
+    , m_busFrames(0)
+    , m_frameCount(0)
 {
 }
 
 AudioFileReader::~AudioFileReader()
 {
-    if (m_pipeline) {
-        GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
-        g_signal_handlers_disconnect_by_func(bus, reinterpret_cast<gpointer>(messageCallback), this);
-        gst_element_set_state(m_pipeline, GST_STATE_NULL);
-        gst_object_unref(GST_OBJECT(m_pipeline));
-    }
-
-    //////////// FIXME WITH PROPER UNREF OR DELETE!!!!
-    /*if (m_decodebin) {
-        g_signal_handlers_disconnect_by_func(m_decodebin, reinterpret_cast<gpointer>(onGStreamerDecodebinPadAddedCallback), this);
-        gst_object_unref(GST_OBJECT(m_decodebin));
-    }*/
-
-    /*if (m_deInterleave) {
-        g_signal_handlers_disconnect_by_func(m_deInterleave, reinterpret_cast<gpointer>(onGStreamerDeinterleavePadAddedCallback), this);
-        g_signal_handlers_disconnect_by_func(m_deInterleave, reinterpret_cast<gpointer>(onGStreamerDeinterleaveReadyCallback), this);
-        gst_object_unref(GST_OBJECT(m_deInterleave));
-    }*/
-    //////////// FIXME WITH PROPER UNREF OR DELETE!!!!
-
-#ifndef GST_API_VERSION_1
-    gst_buffer_list_iterator_free(m_frontLeftBuffersIterator);
-    gst_buffer_list_iterator_free(m_frontRightBuffersIterator);
-#endif
-    gst_buffer_list_unref(m_frontLeftBuffers);
-    gst_buffer_list_unref(m_frontRightBuffers);
-
-    //FIXME DELETE THE REST OF THE PTRs!!!*/
+    for (float* chunk : m_chunks)
+        delete[] chunk;
 }
 
-#ifndef GST_API_VERSION_1
-GstFlowReturn AudioFileReader::handleBuffer(GstAppSink* sink)
+void AudioFileReader::expectFrames(size_t frames)
 {
-    GstBuffer* buffer = gst_app_sink_pull_buffer(sink);
-    if (!buffer)
-        return GST_FLOW_ERROR;
-
-    GstCaps* caps = gst_buffer_get_caps(buffer);
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
-
-    gint channels = 0;
-    if (!gst_structure_get_int(structure, "channels", &channels) || !channels) {
-        gst_caps_unref(caps);
-        gst_buffer_unref(buffer);
-        return GST_FLOW_ERROR;
-    }
-
-    gint sampleRate = 0;
-    if (!gst_structure_get_int(structure, "rate", &sampleRate) || !sampleRate) {
-        gst_caps_unref(caps);
-        gst_buffer_unref(buffer);
-        return GST_FLOW_ERROR;
-    }
-
-    gint width = 0;
-    if (!gst_structure_get_int(structure, "width", &width) || !width) {
-        gst_caps_unref(caps);
-        gst_buffer_unref(buffer);
-        return GST_FLOW_ERROR;
-    }
-
-    GstClockTime duration = (static_cast<guint64>(GST_BUFFER_SIZE(buffer)) * 8 * GST_SECOND) / (sampleRate * channels * width);
-    int frames = GST_CLOCK_TIME_TO_FRAMES(duration, sampleRate);
-
-    // Check the first audio channel. The buffer is supposed to store
-    // data of a single channel anyway.
-    GstAudioChannelPosition* positions = gst_audio_get_channel_positions(structure);
-    switch (positions[0]) {
-    case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
-        gst_buffer_list_iterator_add(m_frontLeftBuffersIterator, buffer);
-        m_channelSize += frames;
-        break;
-    case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
-        gst_buffer_list_iterator_add(m_frontRightBuffersIterator, buffer);
-        break;
-    default:
-        gst_buffer_unref(buffer);
-        break;
-    }
-
-    g_free(positions);
-    gst_caps_unref(caps);
-    return GST_FLOW_OK;
+    // Decode straight into the bus. Some slack for the resampler rounding,
+    // it's trimmed once we know the real length.
+    m_busFrames = frames + frames / 64 + 1024;
+    m_bus->initialize(channels, m_busFrames, m_sampleRate);
 }
-#else
-GstFlowReturn AudioFileReader::handleSample(GstAppSink* sink)
-{
-    GstSample* sample = gst_app_sink_pull_sample(sink);
-    if (!sample)
-        return GST_FLOW_ERROR;
-
-    GstBuffer* buffer = gst_sample_get_buffer(sample);
-    if (!buffer) {
-        gst_sample_unref(sample);
-        return GST_FLOW_ERROR;
-    }
 
-    GstCaps* caps = gst_sample_get_caps(sample);
-    if (!caps) {
-        gst_sample_unref(sample);
-        return GST_FLOW_ERROR;
+void AudioFileReader::appendFrames(const float* interleaved, size_t frames)
+{
+    if (m_frameCount < m_busFrames) {
+        size_t direct = std::min(frames, m_busFrames - m_frameCount);
+        float* destinations[channels] = { m_bus->channelData(0) + m_frameCount, m_bus->channelData(1) + m_frameCount };
+        VectorMath::deinterleave(interleaved, channels, destinations, direct);
+        m_frameCount += direct;
+        interleaved += direct * channels;
+        frames -= direct;
     }
 
-    GstAudioInfo info;
-    gst_audio_info_from_caps(&info, caps);
-    int frames = GST_CLOCK_TIME_TO_FRAMES(GST_BUFFER_DURATION(buffer), GST_AUDIO_INFO_RATE(&info));
-
-    // Check the first audio channel. The buffer is supposed to store
-    // data of a single channel anyway.
-    switch (GST_AUDIO_INFO_POSITION(&info, 0)) {
-    case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
-        gst_buffer_list_add(m_frontLeftBuffers, gst_buffer_ref(buffer));
-        m_channelSize += frames;
-        break;
-    case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
-        gst_buffer_list_add(m_frontRightBuffers, gst_buffer_ref(buffer));
-        break;
-    default:
-        break;
+    // Unknown duration, or longer than announced. Chunks hold planar frames,
+    // channel after channel.
+    while (frames) {
+        size_t offset = (m_frameCount - m_busFrames) % chunkFrames;
+        if (!offset)
+            m_chunks.push_back(new float[channels * chunkFrames]);
+        float* chunk = m_chunks.back();
+        size_t count = std::min(frames, chunkFrames - offset);
+        float* destinations[channels] = { chunk + offset, chunk + chunkFrames + offset };
+        VectorMath::deinterleave(interleaved, channels, destinations, count);
+        m_frameCount += count;
+        interleaved += count * channels;
+        frames -= count;
     }
-
-    gst_sample_unref(sample);
-    return GST_FLOW_OK;
 }
 
-#endif
-
-static void printGstMessage(GstMessage* msg, bool isError = false)
+void AudioFileReader::finishBus()
 {
-    GError* error = nullptr;
-    gchar* debug = nullptr;
-
-    if (isError)
-        gst_message_parse_error(msg, &error, &debug);
-    else
-        gst_message_parse_warning(msg, &error, &debug);
-
-    g_printerr("%s from element %s: %s\n", (isError) ? "ERROR" : "WARNING", GST_OBJECT_NAME(msg->src), error->message);
-    g_printerr("Debugging info: %s\n", (debug) ? debug : "none");
-
-    g_error_free(error);
-    g_free(debug);
-}
-
-gboolean AudioFileReader::handleMessage(GstMessage* message)
-{
-    switch (GST_MESSAGE_TYPE(message)) {
-    case GST_MESSAGE_EOS:
-        g_main_loop_quit(m_loop);
-        break;
-    case GST_MESSAGE_WARNING:
-        printGstMessage(message);
-        break;
-    case GST_MESSAGE_ERROR:
-        printGstMessage(message, true);
-        m_errorOccurred = true;
-        g_main_loop_quit(m_loop);
-        break;
-    default:
-        break;
+    if (m_frameCount <= m_busFrames) {
+        if (!m_busFrames)
+            m_bus->initialize(channels, 0, m_sampleRate);
+        else if (m_frameCount < m_busFrames)
+            m_bus->resizeSmaller(m_frameCount);
+        return;
     }
 
-    return TRUE;
-}
-
-void AudioFileReader::handleNewDeinterleavePad(GstPad* pad)
-{
-    // A new pad for a planar channel was added in deinterleave. Plug
-    // in an appsink so we can pull the data from each
-    // channel. Pipeline looks like:
-    // ... deinterleave ! queue ! appsink.
-    GstElement* queue = gst_element_factory_make("queue", 0);
-    GstElement* sink = gst_element_factory_make("appsink", 0);
-
-    GstAppSinkCallbacks callbacks;
-    callbacks.eos = 0;
-    callbacks.new_preroll = 0;
-#ifdef GST_API_VERSION_1
-    callbacks.new_sample = onAppsinkNewBufferCallback;
-#else
-    callbacks.new_buffer_list = 0;
-    callbacks.new_buffer = onAppsinkNewBufferCallback;
-#endif
-    gst_app_sink_set_callbacks(GST_APP_SINK(sink), &callbacks, this, 0);
-
-    g_object_set(sink, "sync", FALSE, NULL);
-
-    gst_bin_add_many(GST_BIN(m_pipeline), queue, sink, NULL);
-
-    GstPad* sinkPad = gst_element_get_static_pad(queue, "sink");
-    gst_pad_link(pad, sinkPad);
-    gst_object_unref(GST_OBJECT(sinkPad));
-
-    gst_element_link_pads_full(queue, "src", sink, "sink", GST_PAD_LINK_CHECK_NOTHING);
-
-    gst_element_set_state(queue, GST_STATE_READY);
-    gst_element_set_state(sink, GST_STATE_READY);
-}
-
-void AudioFileReader::deinterleavePadsConfigured()
-{
-    // All deinterleave src pads are now available, let's roll to
-    // PLAYING so data flows towards the sinks and it can be retrieved.
-    gst_element_set_state(m_pipeline, GST_STATE_PLAYING);
-}
-
-void AudioFileReader::plugDeinterleave(GstPad* pad)
-{
-    // A decodebin pad was added, plug in a deinterleave element to
-    // separate each planar channel. Sub pipeline looks like
-    // ... decodebin2 ! audioconvert ! audioresample ! capsfilter ! deinterleave.
-    //FIXME: POSSIBLE LEAKING PTR WARNING
-    GstElement* audioConvert  = gst_element_factory_make("audioconvert", 0);
-    GstElement* audioResample = gst_element_factory_make("audioresample", 0);
-    GstElement* capsFilter = gst_element_factory_make("capsfilter", 0);
-    m_deInterleave = gst_element_factory_make("deinterleave", "deinterleave");
-
-    g_object_set(m_deInterleave, "keep-positions", TRUE, NULL);
-    g_signal_connect(m_deInterleave, "pad-added", G_CALLBACK(onGStreamerDeinterleavePadAddedCallback), this);
-    g_signal_connect(m_deInterleave, "no-more-pads", G_CALLBACK(onGStreamerDeinterleaveReadyCallback), this);
-
-    GstCaps* caps = getGStreamerAudioCaps(2, m_sampleRate);
-    g_object_set(capsFilter, "caps", caps, NULL);
-    gst_caps_unref(caps);
-
-    gst_bin_add_many(GST_BIN(m_pipeline), audioConvert, audioResample, capsFilter, m_deInterleave, NULL);
-
-    GstPad* sinkPad = gst_element_get_static_pad(audioConvert, "sink");
-    gst_pad_link(pad, sinkPad);
-    gst_object_unref(GST_OBJECT(sinkPad));
-
-    gst_element_link_pads_full(audioConvert, "src", audioResample, "sink", GST_PAD_LINK_CHECK_NOTHING);
-    gst_element_link_pads_full(audioResample, "src", capsFilter, "sink", GST_PAD_LINK_CHECK_NOTHING);
-    gst_element_link_pads_full(capsFilter, "src", m_deInterleave, "sink", GST_PAD_LINK_CHECK_NOTHING);
-
-    gst_element_sync_state_with_parent(audioConvert);
-    gst_element_sync_state_with_parent(audioResample);
-    gst_element_sync_state_with_parent(capsFilter);
-    gst_element_sync_state_with_parent(m_deInterleave);
-}
-
-void AudioFileReader::decodeAudioForBusCreation()
-{
-    // Build the pipeline (giostreamsrc | filesrc) ! decodebin2
-    // A deinterleave element is added once a src pad becomes available in decodebin.
-    m_pipeline = gst_pipeline_new(0);
-
-    //FIXME: POSSIBLE LEAKING PTR WARNING
-    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(m_pipeline));
-    gst_bus_add_signal_watch(bus);
-    g_signal_connect(bus, "message", G_CALLBACK(messageCallback), this);
-
-    GstElement* source = gst_element_factory_make("giostreamsrc", 0);
-    //FIXME: POSSIBLE LEAKING PTR WARNING
-    GInputStream* memoryStream = g_memory_input_stream_new_from_data(m_data, m_dataSize, 0);
-    g_object_set(source, "stream", memoryStream, NULL);
-
-#ifdef GST_API_VERSION_1
-    m_decodebin = gst_element_factory_make("decodebin", 0);
-#else
-    m_decodebin = gst_element_factory_make("decodebin2", 0);
-#endif
-
-    g_signal_connect(m_decodebin, "pad-added", G_CALLBACK(onGStreamerDecodebinPadAddedCallback), this);
-    gst_bin_add_many(GST_BIN(m_pipeline), source, m_decodebin, NULL);
-    gst_element_link_pads_full(source, "src", m_decodebin, "sink", GST_PAD_LINK_CHECK_NOTHING);
-    gst_element_set_state(m_pipeline, GST_STATE_PAUSED);
+    // Some frames ended up in chunks, so the bus has to be (re)allocated at
+    // its final size. Anything decoded in it already has to move over.
+    std::vector<float> head[channels];
+    for (unsigned channel = 0; channel < channels && m_busFrames; ++channel)
+        head[channel].assign(m_bus->channelData(channel), m_bus->channelData(channel) + m_busFrames);
+
+    m_bus->initialize(channels, m_frameCount, m_sampleRate);
+    for (unsigned channel = 0; channel < channels; ++channel) {
+        float* destination = m_bus->channelData(channel);
+        if (m_busFrames)
+            memcpy(destination, head[channel].data(), m_busFrames * sizeof(float));
+        destination += m_busFrames;
+
+        size_t remaining = m_frameCount - m_busFrames;
+        for (float* chunk : m_chunks) {
+            size_t count = std::min(remaining, chunkFrames);
+            memcpy(destination, chunk + channel * chunkFrames, count * sizeof(float));
+            destination += count;
+            remaining -= count;
+        }
+    }
 }
 
 bool AudioFileReader::createBus(AudioBus* destinationBus, float sampleRate)
 {
-    m_sampleRate = sampleRate;
-
-    m_frontLeftBuffers = gst_buffer_list_new();
-    m_frontRightBuffers = gst_buffer_list_new();
-
-#ifndef GST_API_VERSION_1
-    m_frontLeftBuffersIterator = gst_buffer_list_iterate(m_frontLeftBuffers);
-    gst_buffer_list_iterator_add_group(m_frontLeftBuffersIterator);
-
-    m_frontRightBuffersIterator = gst_buffer_list_iterate(m_frontRightBuffers);
-    gst_buffer_list_iterator_add_group(m_frontRightBuffersIterator);
-#endif
-
-    //FIXME: POSSIBLE LEAKING PTR WARNING
-    GMainContext* context = g_main_context_new();
-    g_main_context_push_thread_default(context);
-    m_loop = g_main_loop_new(context, FALSE);
-
-    // Start the pipeline processing just after the loop is started.
-    GSource* timeoutSource = g_timeout_source_new(0);
-    g_source_attach(timeoutSource, context);
-    g_source_set_callback(timeoutSource, reinterpret_cast<GSourceFunc>(enteredMainLoopCallback), this, 0);
+    // Plain WAV files don't need a pipeline at all.
+    if (AudioConfig::get().wavDecoder && WavDecoder::sniff(m_data, m_dataSize)) {
+        WavDecoder wav(m_data, m_dataSize);
+        if (wav.canDecode(sampleRate))
+            return wav.createBus(destinationBus, sampleRate);
+    }
 
-    g_main_loop_run(m_loop);
-    g_main_context_pop_thread_default(context);
+    DecodedAudioCache* cache = DecodedAudioCache::get();
+    DecodedAudioCache::Key key;
+    if (cache) {
+        key = DecodedAudioCache::key(m_data, m_dataSize, sampleRate);
+        if (cache->lookup(key, destinationBus))
+            return true;
+    }
 
-    if (m_errorOccurred)
+    m_sampleRate = sampleRate;
+    m_bus = destinationBus;
+    if (!AudioDecodeWorker::get().decode(this, m_data, m_dataSize, sampleRate))
         return false;
 
-    // This allocates everything for us (stereo)! :)
-    destinationBus->initialize(2, m_channelSize, m_sampleRate);
-
-    copyGStreamerBuffersToAudioChannel(m_frontLeftBuffers, destinationBus->channelData(0));
-    copyGStreamerBuffersToAudioChannel(m_frontRightBuffers, destinationBus->channelData(1));
-
+    // Frames went to the bus as they were decoded, only trim it, or gather
+    // what didn't fit.
+    finishBus();
+    if (cache)
+        cache->store(key, destinationBus, channels, m_frameCount);
     return true;
 }
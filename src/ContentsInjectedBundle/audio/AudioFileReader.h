@@ -1,50 +1,38 @@
 #ifndef AudioFileReader_h
 #define AudioFileReader_h
 
-#include <gst/gst.h>
-#include <gst/app/gstappsink.h>
-
 #include <NixPlatform/Platform.h>
+#include <vector>
 
 class AudioFileReader {
 public:
     AudioFileReader(const void* data, size_t dataSize);
     ~AudioFileReader();
 
-    static Nix::Data loadResource(const char* name);
-
     bool createBus(Nix::AudioBus* destinationBus, float sampleRate);
 
-#ifdef GST_API_VERSION_1
-    GstFlowReturn handleSample(GstAppSink*);
-#else
-    GstFlowReturn handleBuffer(GstAppSink*);
-#endif
+    // Decoded files are always stereo.
+    static const unsigned channels = 2;
 
-    gboolean handleMessage(GstMessage*);
-    void handleNewDeinterleavePad(GstPad*);
-    void deinterleavePadsConfigured();
-    void plugDeinterleave(GstPad*);
-    void decodeAudioForBusCreation();
+    // Called by AudioDecodeWorker from the streaming thread, while createBus()
+    // waits for the end of the stream.
+    void expectFrames(size_t frames);
+    void appendFrames(const float* interleaved, size_t frames);
 
 private:
+    void finishBus();
+
     const void* m_data;
     size_t m_dataSize;
     float m_sampleRate;
 
-    GstBufferList* m_frontLeftBuffers;
-    GstBufferList* m_frontRightBuffers;
-#ifndef GST_API_VERSION_1
-    GstBufferListIterator* m_frontLeftBuffersIterator;
-    GstBufferListIterator* m_frontRightBuffersIterator;
-#endif
-
-    GstElement* m_pipeline;
-    unsigned m_channelSize;
-    GstElement* m_decodebin;
-    GstElement* m_deInterleave;
-    GMainLoop* m_loop;
-    bool m_errorOccurred;
+    // Frames are deinterleaved into the bus as they're decoded when the
+    // duration is known up front, m_busFrames being what it was allocated
+    // for. The rest goes to m_chunks until the end of the stream.
+    Nix::AudioBus* m_bus;
+    size_t m_busFrames;
+    size_t m_frameCount;
+    std::vector<float*> m_chunks;
 };
 
 #endif
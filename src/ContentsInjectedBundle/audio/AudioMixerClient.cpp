@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioMixerClient.h"
+#include "AudioConfig.h"
+#include "AudioMixerProtocol.h"
+#include "AudioRingBuffer.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <gst/gst.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+GST_DEBUG_CATEGORY_STATIC(webkit_audio_mixer_client_debug);
+#define GST_CAT_DEFAULT webkit_audio_mixer_client_debug
+
+// While the mixer isn't reading from us for silence, WebCore is woken up this
+// often to render the quanta that are due, the pace of WebKitWebAudioSrc.
+static const std::chrono::milliseconds suspendedRenderInterval(50);
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+// The mixer only maps memory that can't be resized under it, so this needs a
+// sealable memfd. Without one the web process just plays on its own.
+static int createSharedMemory(size_t size)
+{
+#ifdef SYS_memfd_create
+    int fd = syscall(SYS_memfd_create, "drowser-audio", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+    errno = ENOSYS;
+    int fd = -1;
+#endif
+    if (fd < 0)
+        return -1;
+    if (ftruncate(fd, size) || fcntl(fd, F_ADD_SEALS, AudioMixerProtocol::requiredSeals)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+AudioMixerClient* AudioMixerClient::create(size_t bufferSize, unsigned numberOfInputChannels, unsigned numberOfChannels, double sampleRate, Nix::AudioDevice::RenderCallback* callback)
+{
+    const char* socketName = getenv(AudioMixerProtocol::socketNameVariable);
+    const char* mixerRate = getenv(AudioMixerProtocol::sampleRateVariable);
+    if (!socketName || !*socketName || !mixerRate)
+        return 0;
+
+    // The mixer neither captures nor converts, anything it can't take plays on its own.
+    if (numberOfInputChannels || numberOfChannels != AudioMixerProtocol::channels || atof(mixerRate) != sampleRate)
+        return 0;
+
+    AudioMixerClient* client = new AudioMixerClient(bufferSize, sampleRate, callback);
+    if (!client->connect(socketName)) {
+        delete client;
+        return 0;
+    }
+    return client;
+}
+
+AudioMixerClient::AudioMixerClient(size_t bufferSize, double sampleRate, Nix::AudioDevice::RenderCallback* callback)
+    : m_bufferSize(bufferSize)
+    , m_sampleRate(sampleRate)
+    , m_callback(callback)
+    , m_socket(-1)
+    , m_eventFd(-1)
+    , m_memory(MAP_FAILED)
+    , m_memorySize(0)
+    , m_ring(0)
+    , m_targetFrames(0)
+    , m_running(false)
+    , m_statsTimer(0)
+    , m_suspendAfter(static_cast<uint64_t>(AudioConfig::get().suspendAfter * sampleRate))
+    , m_silentFrames(0)
+    , m_destinationData(static_cast<size_t>(AudioMixerProtocol::channels))
+{
+    if (!webkit_audio_mixer_client_debug)
+        GST_DEBUG_CATEGORY_INIT(webkit_audio_mixer_client_debug, "webkitaudiomixerclient", 0, "WebAudio mixer client");
+
+    m_channelData = new float[bufferSize * AudioMixerProtocol::channels]();
+    for (unsigned i = 0; i < AudioMixerProtocol::channels; ++i) {
+        m_destinationData[i] = m_channelData + i * bufferSize;
+        m_channelPointers[i] = m_destinationData[i];
+    }
+    AudioThread::lockMemory(m_channelData, bufferSize * AudioMixerProtocol::channels * sizeof(float));
+    m_stats.setDeadline(static_cast<uint64_t>(bufferSize * 1e9 / sampleRate));
+
+    if (unsigned interval = AudioConfig::get().statsInterval) {
+        m_statsTimer = g_timeout_add_seconds(interval, [](gpointer data) -> gboolean {
+            std::cerr << "[Audio pid " << getpid() << " via mixer] ";
+            AudioRenderStats::print(std::cerr, static_cast<AudioMixerClient*>(data)->renderStats());
+            return TRUE;
+        }, this);
+    }
+}
+
+AudioMixerClient::~AudioMixerClient()
+{
+    stop();
+    if (m_statsTimer)
+        g_source_remove(m_statsTimer);
+
+    // Closing the socket tells the mixer to forget about the ring before we unmap it.
+    if (m_socket >= 0)
+        close(m_socket);
+    delete m_ring;
+    if (m_memory != MAP_FAILED)
+        munmap(m_memory, m_memorySize);
+    if (m_eventFd >= 0)
+        close(m_eventFd);
+
+    AudioThread::unlockMemory(m_channelData, m_bufferSize * AudioMixerProtocol::channels * sizeof(float));
+    delete[] m_channelData;
+}
+
+bool AudioMixerClient::connect(const char* socketName)
+{
+    m_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+        return false;
+
+    // Abstract socket, the name starts with a null byte and isn't null terminated.
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    size_t nameLength = std::min(strlen(socketName), sizeof(address.sun_path) - 1);
+    memcpy(address.sun_path + 1, socketName, nameLength);
+    if (::connect(m_socket, reinterpret_cast<sockaddr*>(&address), offsetof(sockaddr_un, sun_path) + 1 + nameLength)) {
+        GST_WARNING("Can't connect to the audio mixer: %s", strerror(errno));
+        return false;
+    }
+
+    // Keep the prebuffer and one mixer period ready, with room for the quantum being written.
+    m_targetFrames = std::max<size_t>(AudioConfig::get().prebufferFrames(m_bufferSize, m_sampleRate), m_bufferSize) + AudioMixerProtocol::periodFrames;
+    size_t capacity = m_targetFrames + m_bufferSize;
+    m_memorySize = AudioRingBuffer::memorySize(AudioMixerProtocol::channels, capacity);
+
+    int memoryFd = createSharedMemory(m_memorySize);
+    if (memoryFd < 0) {
+        GST_WARNING("Can't create the shared ring: %s", strerror(errno));
+        return false;
+    }
+    m_memory = mmap(0, m_memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, memoryFd, 0);
+    if (m_memory == MAP_FAILED) {
+        close(memoryFd);
+        return false;
+    }
+    m_ring = new AudioRingBuffer(m_memory, AudioMixerProtocol::channels, capacity, capacity);
+    AudioThread::lockMemory(m_memory, m_memorySize);
+
+    m_eventFd = eventfd(0, EFD_CLOEXEC);
+    if (m_eventFd < 0) {
+        close(memoryFd);
+        return false;
+    }
+
+    AudioMixerProtocol::Message hello = { AudioMixerProtocol::Hello, static_cast<uint32_t>(m_memorySize) };
+    int descriptors[] = { memoryFd, m_eventFd };
+    bool sent = AudioMixerProtocol::sendMessage(m_socket, hello, descriptors, 2);
+    close(memoryFd);
+    if (!sent)
+        GST_WARNING("Can't register with the audio mixer: %s", strerror(errno));
+    return sent;
+}
+
+void AudioMixerClient::start()
+{
+    if (m_running)
+        return;
+
+    sendRunning(true);
+    m_silentFrames = 0;
+    m_running = true;
+    m_thread = std::thread(&AudioMixerClient::renderLoop, this);
+}
+
+void AudioMixerClient::stop()
+{
+    if (!m_running)
+        return;
+
+    m_running = false;
+    wakeUp();
+    m_thread.join();
+
+    // The render thread is gone, so this comes after any Start it sent when resuming.
+    sendRunning(false);
+}
+
+// Start and Stop only tell the mixer whether to read from our ring.
+void AudioMixerClient::sendRunning(bool running)
+{
+    AudioMixerProtocol::Message message = { static_cast<uint32_t>(running ? AudioMixerProtocol::Start : AudioMixerProtocol::Stop), 0 };
+    AudioMixerProtocol::sendMessage(m_socket, message, 0, 0);
+}
+
+void AudioMixerClient::wakeUp()
+{
+    uint64_t value = 1;
+    ssize_t written = write(m_eventFd, &value, sizeof(value));
+    (void)written;
+}
+
+void AudioMixerClient::renderLoop()
+{
+    m_audioThread.enter();
+
+    while (m_running) {
+        while (m_running && m_ring->framesAvailable() + m_bufferSize <= m_targetFrames) {
+            renderQuantum();
+            m_ring->write(m_channelPointers, m_bufferSize);
+            if (!countSilence())
+                continue;
+
+            // The mixer stops reading from the ring and writing to the eventfd.
+            GST_INFO("Output is silent, suspending it");
+            sendRunning(false);
+            if (!renderSuspended())
+                break;
+            // What's left in the ring is silence, there's room for the quantum ending it.
+            GST_INFO("Output isn't silent anymore, resuming it");
+            m_ring->write(m_channelPointers, m_bufferSize);
+            sendRunning(true);
+        }
+
+        // The mixer writes to the eventfd after each period it took from us, stop() too.
+        uint64_t value;
+        ssize_t bytesRead;
+        do {
+            bytesRead = read(m_eventFd, &value, sizeof(value));
+        } while (bytesRead < 0 && errno == EINTR);
+    }
+
+    m_audioThread.leave();
+}
+
+void AudioMixerClient::renderQuantum()
+{
+    uint64_t renderStart = AudioRenderStats::now();
+    m_callback->render(m_sourceData, m_destinationData, m_bufferSize);
+    m_stats.recordRender(renderStart, AudioRenderStats::now() - renderStart);
+}
+
+// Called for every quantum rendered at full rate, returns true once the output has
+// been silent for long enough. Only exact zeros count, anything else may be the
+// quiet start of a sound.
+bool AudioMixerClient::countSilence()
+{
+    if (!m_suspendAfter)
+        return false;
+
+    if (VectorMath::maximumMagnitude(m_channelData, m_bufferSize * AudioMixerProtocol::channels)) {
+        m_silentFrames = 0;
+        return false;
+    }
+    m_silentFrames += m_bufferSize;
+    if (m_silentFrames < m_suspendAfter)
+        return false;
+    m_silentFrames = 0;
+    return true;
+}
+
+// Renders while the mixer isn't reading from us. Every suspendedRenderInterval the
+// quanta due since the suspension are rendered back to back, so the context time
+// keeps up with the wall clock without waking up for each of them. Returns true
+// with the first quantum that isn't silent in m_channelData, false when stopping.
+bool AudioMixerClient::renderSuspended()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point wakeup = start;
+    uint64_t framesDone = 0;
+
+    while (m_running) {
+        wakeup += suspendedRenderInterval;
+        waitUntil(wakeup);
+        if (!m_running)
+            break;
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t framesDue = static_cast<uint64_t>(elapsed * m_sampleRate);
+        for (; framesDone + m_bufferSize <= framesDue; framesDone += m_bufferSize) {
+            renderQuantum();
+            if (VectorMath::maximumMagnitude(m_channelData, m_bufferSize * AudioMixerProtocol::channels))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Sleeps until deadline, unless stop() wakes us up. The mixer may still write to
+// the eventfd for a period or two before it handles Stop, those are just drained.
+void AudioMixerClient::waitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    while (m_running) {
+        int timeout = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (timeout <= 0)
+            return;
+        pollfd event = { m_eventFd, POLLIN, 0 };
+        if (poll(&event, 1, timeout) > 0) {
+            uint64_t value;
+            ssize_t bytesRead = read(m_eventFd, &value, sizeof(value));
+            (void)bytesRead;
+        }
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioMixerClient_h
+#define AudioMixerClient_h
+
+#include "AudioRenderStats.h"
+#include "AudioThread.h"
+#include <atomic>
+#include <chrono>
+#include <glib.h>
+#include <NixPlatform/Platform.h>
+#include <thread>
+
+class AudioRingBuffer;
+
+// Audio device that hands its output to the mixer of the Browser process
+// instead of running a pipeline of its own, see AudioMixerProtocol.h. WebCore
+// renders from a thread of ours into a ring shared with the mixer, and that
+// thread sleeps on an eventfd until the mixer made room. After a while of
+// digital silence it tells the mixer to stop reading from the ring, and only
+// wakes up every so often to render what's due, like WebKitWebAudioSrc.
+class AudioMixerClient : public Nix::AudioDevice {
+public:
+    // Returns 0 when there's no mixer or it can't take this stream, the caller then plays on its own.
+    static AudioMixerClient* create(size_t bufferSize, unsigned numberOfInputChannels, unsigned numberOfChannels, double sampleRate, Nix::AudioDevice::RenderCallback*);
+    virtual ~AudioMixerClient();
+
+    virtual void start();
+    virtual void stop();
+
+    AudioRenderStats::Snapshot renderStats() const { return m_stats.snapshot(); }
+
+private:
+    AudioMixerClient(size_t bufferSize, double sampleRate, Nix::AudioDevice::RenderCallback*);
+    bool connect(const char* socketName);
+    void renderLoop();
+    void renderQuantum();
+    bool countSilence();
+    bool renderSuspended();
+    void waitUntil(std::chrono::steady_clock::time_point);
+    void sendRunning(bool);
+    void wakeUp();
+
+    size_t m_bufferSize;
+    double m_sampleRate;
+    Nix::AudioDevice::RenderCallback* m_callback;
+
+    int m_socket;
+    int m_eventFd;
+    void* m_memory;
+    size_t m_memorySize;
+    AudioRingBuffer* m_ring;
+    size_t m_targetFrames;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    AudioThread m_audioThread;
+    AudioRenderStats m_stats;
+    guint m_statsTimer;
+
+    // Frames of digital silence after which the mixer is told to stop, 0 never does.
+    uint64_t m_suspendAfter;
+    uint64_t m_silentFrames;
+
+    float* m_channelData;
+    const float* m_channelPointers[2];
+    Nix::Vector<float*> m_sourceData;
+    Nix::Vector<float*> m_destinationData;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioRenderStats.h"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+
+// Weight of the newest quantum in the load average, about 50ms worth of
+// quanta at 128 frames and 44.1kHz.
+static const double loadSmoothing = 1.0 / 16;
+
+// Upper bounds of the histogram buckets, in percent of the deadline.
+static const unsigned histogramBounds[AudioRenderStats::HistogramSize - 1] = { 10, 25, 50, 75, 100, 150, 200 };
+
+AudioRenderStats::AudioRenderStats()
+    : m_deadline(0)
+    , m_quanta(0)
+    , m_lateQuanta(0)
+    , m_lastLateTimestamp(0)
+    , m_renderTime(0)
+    , m_renderTimeMax(0)
+    , m_pushes(0)
+    , m_pushTime(0)
+    , m_pushTimeMax(0)
+    , m_underruns(0)
+    , m_sinkQoS(0)
+    , m_sinkWarnings(0)
+    , m_load(0)
+    , m_loadPermyriad(0)
+{
+    for (unsigned i = 0; i < HistogramSize; ++i)
+        m_histogram[i].store(0, std::memory_order_relaxed);
+}
+
+uint64_t AudioRenderStats::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void AudioRenderStats::setDeadline(uint64_t deadline)
+{
+    m_deadline.store(deadline, std::memory_order_relaxed);
+}
+
+void AudioRenderStats::recordRender(uint64_t start, uint64_t renderTime)
+{
+    uint64_t deadline = m_deadline.load(std::memory_order_relaxed);
+    if (!deadline)
+        return;
+
+    // Single writer, so plain load and store pairs are enough.
+    m_quanta.store(m_quanta.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_renderTime.store(m_renderTime.load(std::memory_order_relaxed) + renderTime, std::memory_order_relaxed);
+    if (renderTime > m_renderTimeMax.load(std::memory_order_relaxed))
+        m_renderTimeMax.store(renderTime, std::memory_order_relaxed);
+
+    // Rendering alone took longer than the audio it produced, the sink is going to run dry.
+    if (renderTime > deadline) {
+        m_lateQuanta.store(m_lateQuanta.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_lastLateTimestamp.store(start, std::memory_order_relaxed);
+    }
+
+    uint64_t percent = renderTime * 100 / deadline;
+    unsigned bucket = std::upper_bound(histogramBounds, histogramBounds + HistogramSize - 1, percent) - histogramBounds;
+    m_histogram[bucket].store(m_histogram[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    m_load += (static_cast<double>(renderTime) / deadline - m_load) * loadSmoothing;
+    m_loadPermyriad.store(static_cast<uint32_t>(m_load * 10000), std::memory_order_relaxed);
+}
+
+void AudioRenderStats::recordPush(uint64_t pushTime)
+{
+    m_pushes.store(m_pushes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_pushTime.store(m_pushTime.load(std::memory_order_relaxed) + pushTime, std::memory_order_relaxed);
+    if (pushTime > m_pushTimeMax.load(std::memory_order_relaxed))
+        m_pushTimeMax.store(pushTime, std::memory_order_relaxed);
+}
+
+void AudioRenderStats::recordUnderrun(uint64_t frames)
+{
+    m_underruns.store(m_underruns.load(std::memory_order_relaxed) + frames, std::memory_order_relaxed);
+}
+
+AudioRenderStats::Snapshot AudioRenderStats::snapshot() const
+{
+    Snapshot snapshot;
+    snapshot.timestamp = now();
+    snapshot.deadline = m_deadline.load(std::memory_order_relaxed);
+    snapshot.quanta = m_quanta.load(std::memory_order_relaxed);
+    snapshot.lateQuanta = m_lateQuanta.load(std::memory_order_relaxed);
+    snapshot.lastLateTimestamp = m_lastLateTimestamp.load(std::memory_order_relaxed);
+    snapshot.renderTimeAverage = snapshot.quanta ? m_renderTime.load(std::memory_order_relaxed) / snapshot.quanta : 0;
+    snapshot.renderTimeMax = m_renderTimeMax.load(std::memory_order_relaxed);
+    uint64_t pushes = m_pushes.load(std::memory_order_relaxed);
+    snapshot.pushTimeAverage = pushes ? m_pushTime.load(std::memory_order_relaxed) / pushes : 0;
+    snapshot.pushTimeMax = m_pushTimeMax.load(std::memory_order_relaxed);
+    snapshot.underruns = m_underruns.load(std::memory_order_relaxed);
+    snapshot.load = m_loadPermyriad.load(std::memory_order_relaxed) / 100.0;
+    for (unsigned i = 0; i < HistogramSize; ++i)
+        snapshot.histogram[i] = m_histogram[i].load(std::memory_order_relaxed);
+    snapshot.sinkQoS = m_sinkQoS.load(std::memory_order_relaxed);
+    snapshot.sinkWarnings = m_sinkWarnings.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+static double toMicroseconds(uint64_t nanoseconds)
+{
+    return nanoseconds / 1000.0;
+}
+
+void AudioRenderStats::print(std::ostream& out, const Snapshot& snapshot)
+{
+    out << std::fixed << std::setprecision(1)
+        << snapshot.timestamp / 1000000 << "ms load " << snapshot.load << "%"
+        << ", " << snapshot.quanta << " quanta, " << snapshot.lateQuanta << " late";
+    if (snapshot.lateQuanta)
+        out << " (last at " << snapshot.lastLateTimestamp / 1000000 << "ms)";
+    out << ", render avg " << toMicroseconds(snapshot.renderTimeAverage) << "us max " << toMicroseconds(snapshot.renderTimeMax)
+        << "us of " << toMicroseconds(snapshot.deadline) << "us"
+        << ", push avg " << toMicroseconds(snapshot.pushTimeAverage) << "us max " << toMicroseconds(snapshot.pushTimeMax) << "us"
+        << ", underruns " << snapshot.underruns << " frames"
+        << ", sink qos " << snapshot.sinkQoS << " warnings " << snapshot.sinkWarnings
+        << ", histogram";
+    for (unsigned i = 0; i < HistogramSize; ++i) {
+        out << " ";
+        if (i < HistogramSize - 1)
+            out << "<" << histogramBounds[i];
+        else
+            out << ">=" << histogramBounds[i - 1];
+        out << "%:" << snapshot.histogram[i];
+    }
+    out << std::endl;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioRenderStats_h
+#define AudioRenderStats_h
+
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+// Timing of the Web Audio render loop. The render thread records how long each
+// quantum took to render, the streaming thread how long pushing it downstream
+// took, the main thread records what the sink reports on the bus, and anybody
+// can take a snapshot at any time. Rendering and pushing can happen on the
+// same thread or on different ones, but each has a single writer.
+// Times are in nanoseconds from CLOCK_MONOTONIC, like IPCTracer, so both can be
+// lined up when looking for the cause of a dropout.
+class AudioRenderStats
+{
+public:
+    // Render times are bucketed by the fraction of the quantum deadline they took:
+    // <10%, <25%, <50%, <75%, <100%, <150%, <200% and the rest.
+    static const unsigned HistogramSize = 8;
+
+    struct Snapshot {
+        uint64_t timestamp;
+        uint64_t deadline;
+        uint64_t quanta;
+        uint64_t lateQuanta;
+        uint64_t lastLateTimestamp;
+        uint64_t renderTimeAverage;
+        uint64_t renderTimeMax;
+        uint64_t pushTimeAverage;
+        uint64_t pushTimeMax;
+        uint64_t underruns; // Frames of silence pushed because rendering fell behind.
+        double load; // Moving average of render time / deadline, in percent.
+        uint64_t histogram[HistogramSize];
+        uint64_t sinkQoS;
+        uint64_t sinkWarnings;
+    };
+
+    AudioRenderStats();
+
+    void setDeadline(uint64_t);
+    uint64_t deadline() const { return m_deadline.load(std::memory_order_relaxed); }
+
+    // Render thread only.
+    void recordRender(uint64_t start, uint64_t renderTime);
+    // Streaming thread only.
+    void recordPush(uint64_t pushTime);
+    void recordUnderrun(uint64_t frames);
+
+    // Main thread, from the pipeline bus.
+    void recordSinkQoS() { m_sinkQoS.fetch_add(1, std::memory_order_relaxed); }
+    void recordSinkWarning() { m_sinkWarnings.fetch_add(1, std::memory_order_relaxed); }
+
+    Snapshot snapshot() const;
+    static void print(std::ostream&, const Snapshot&);
+
+    static uint64_t now();
+
+private:
+    std::atomic<uint64_t> m_deadline;
+    std::atomic<uint64_t> m_quanta;
+    std::atomic<uint64_t> m_lateQuanta;
+    std::atomic<uint64_t> m_lastLateTimestamp;
+    std::atomic<uint64_t> m_renderTime;
+    std::atomic<uint64_t> m_renderTimeMax;
+    std::atomic<uint64_t> m_pushes;
+    std::atomic<uint64_t> m_pushTime;
+    std::atomic<uint64_t> m_pushTimeMax;
+    std::atomic<uint64_t> m_underruns;
+    std::atomic<uint64_t> m_histogram[HistogramSize];
+    std::atomic<uint64_t> m_sinkQoS;
+    std::atomic<uint64_t> m_sinkWarnings;
+
+    // Only touched by the render thread, published through m_loadPermyriad.
+    double m_load;
+    std::atomic<uint32_t> m_loadPermyriad;
+};
+
+#endif
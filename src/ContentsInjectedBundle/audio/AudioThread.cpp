@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioThread.h"
+#include "AudioConfig.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
+#include <mutex>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(webkit_audio_thread_debug);
+#define GST_CAT_DEFAULT webkit_audio_thread_debug
+
+// rtkit only serves processes whose RLIMIT_RTTIME hard limit is at most this,
+// so a real-time thread spinning without blocking is killed by the kernel.
+static const rlim_t realtimeCpuTimeLimit = 200000; // us
+// The soft limit raises SIGXCPU first, so an overrun is reported before it's fatal.
+static const rlim_t realtimeCpuTimeWarning = 150000; // us
+
+// The limit is per process and real-time threads come and go, so the first one
+// lowers it and the last one puts it back.
+static std::mutex cpuTimeLimitMutex;
+static unsigned cpuTimeLimitUsers;
+static bool cpuTimeLimitChanged;
+static rlimit previousCpuTimeLimit;
+static bool cpuTimeSignalChanged;
+static struct sigaction previousCpuTimeSignal;
+
+static void warnRealtimeCpuTime(int)
+{
+    static const char message[] = "Web Audio render thread ran 150ms without blocking, the kernel kills it at 200ms\n";
+    ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+    (void)written;
+}
+
+static void limitRealtimeCpuTime()
+{
+    std::lock_guard<std::mutex> lock(cpuTimeLimitMutex);
+    if (cpuTimeLimitUsers++)
+        return;
+
+    // Somebody already asked for as low a limit as rtkit needs, whatever soft limit goes with it is theirs.
+    if (getrlimit(RLIMIT_RTTIME, &previousCpuTimeLimit)
+        || (previousCpuTimeLimit.rlim_max != RLIM_INFINITY && previousCpuTimeLimit.rlim_max <= realtimeCpuTimeLimit))
+        return;
+
+    // SIGXCPU terminates the process by default, only replace that.
+    sigaction(SIGXCPU, 0, &previousCpuTimeSignal);
+    if (!(previousCpuTimeSignal.sa_flags & SA_SIGINFO) && previousCpuTimeSignal.sa_handler == SIG_DFL) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = warnRealtimeCpuTime;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        cpuTimeSignalChanged = !sigaction(SIGXCPU, &action, 0);
+    }
+
+    rlimit limit;
+    limit.rlim_max = realtimeCpuTimeLimit;
+    limit.rlim_cur = std::min(previousCpuTimeLimit.rlim_cur, realtimeCpuTimeWarning);
+    cpuTimeLimitChanged = !setrlimit(RLIMIT_RTTIME, &limit);
+    if (!cpuTimeLimitChanged && cpuTimeSignalChanged) {
+        sigaction(SIGXCPU, &previousCpuTimeSignal, 0);
+        cpuTimeSignalChanged = false;
+    }
+}
+
+static void restoreRealtimeCpuTime()
+{
+    std::lock_guard<std::mutex> lock(cpuTimeLimitMutex);
+    if (--cpuTimeLimitUsers)
+        return;
+
+    if (cpuTimeLimitChanged && setrlimit(RLIMIT_RTTIME, &previousCpuTimeLimit)) {
+        // Raising a hard limit again takes CAP_SYS_RESOURCE, without it only the soft limit comes back.
+        rlimit limit;
+        if (!getrlimit(RLIMIT_RTTIME, &limit)) {
+            limit.rlim_cur = std::min(previousCpuTimeLimit.rlim_cur, limit.rlim_max);
+            setrlimit(RLIMIT_RTTIME, &limit);
+        }
+    }
+    if (cpuTimeSignalChanged)
+        sigaction(SIGXCPU, &previousCpuTimeSignal, 0);
+    cpuTimeLimitChanged = false;
+    cpuTimeSignalChanged = false;
+}
+
+static unsigned floatingPointState()
+{
+#if defined(__SSE__)
+    return _mm_getcsr();
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+#elif defined(__ARM_NEON__) || defined(__VFP_FP__) && !defined(__SOFTFP__)
+    unsigned fpscr;
+    asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+    return fpscr;
+#else
+    return 0;
+#endif
+}
+
+static void setFloatingPointState(unsigned state)
+{
+#if defined(__SSE__)
+    _mm_setcsr(state);
+#elif defined(__aarch64__)
+    uint64_t fpcr = state;
+    asm volatile("msr fpcr, %0" : : "r"(fpcr));
+#elif defined(__ARM_NEON__) || defined(__VFP_FP__) && !defined(__SOFTFP__)
+    asm volatile("vmsr fpscr, %0" : : "r"(state));
+#else
+    (void)state;
+#endif
+}
+
+static unsigned flushDenormalsState(unsigned state)
+{
+#if defined(__SSE__)
+    // FTZ (bit 15) and DAZ (bit 6).
+    return state | 0x8040;
+#elif defined(__aarch64__) || defined(__ARM_NEON__) || defined(__VFP_FP__) && !defined(__SOFTFP__)
+    // FZ (bit 24), ARM flushes denormal inputs as well when it's set.
+    return state | (1 << 24);
+#else
+    return state;
+#endif
+}
+
+AudioThread::AudioThread()
+    : m_schedulingChanged(false)
+    , m_cpuTimeLimited(false)
+    , m_policy(SCHED_OTHER)
+    , m_floatingPointStateChanged(false)
+    , m_floatingPointState(0)
+    , m_affinityChanged(false)
+{
+    if (!webkit_audio_thread_debug)
+        GST_DEBUG_CATEGORY_INIT(webkit_audio_thread_debug, "webkitaudiothread", 0, "WebAudio render thread");
+    memset(&m_parameters, 0, sizeof(m_parameters));
+    CPU_ZERO(&m_affinity);
+}
+
+void AudioThread::enter()
+{
+    const AudioConfig& config = AudioConfig::get();
+
+    // Without a device the sink doesn't sync and the thread never blocks. It
+    // would hog a core at real-time priority, or be killed by the RLIMIT_RTTIME
+    // rtkit requires as soon as a render takes longer than that.
+    if (config.realtime && config.output == AudioConfig::DeviceOutput) {
+        pthread_getschedparam(pthread_self(), &m_policy, &m_parameters);
+        m_schedulingChanged = setRealtimePriority(config.realtimePriority);
+    }
+
+    if (config.flushDenormals) {
+        m_floatingPointState = floatingPointState();
+        setFloatingPointState(flushDenormalsState(m_floatingPointState));
+        m_floatingPointStateChanged = true;
+    }
+
+    if (config.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        pthread_getaffinity_np(pthread_self(), sizeof(m_affinity), &m_affinity);
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        m_affinityChanged = !error;
+        if (error)
+            GST_WARNING("Can't pin the render thread to CPU %d: %s", config.cpu, strerror(error));
+        else
+            GST_INFO("Render thread pinned to CPU %d", config.cpu);
+    }
+}
+
+void AudioThread::leave()
+{
+    if (m_schedulingChanged) {
+        pthread_setschedparam(pthread_self(), m_policy, &m_parameters);
+        m_schedulingChanged = false;
+    }
+    if (m_cpuTimeLimited) {
+        restoreRealtimeCpuTime();
+        m_cpuTimeLimited = false;
+    }
+    if (m_floatingPointStateChanged) {
+        setFloatingPointState(m_floatingPointState);
+        m_floatingPointStateChanged = false;
+    }
+    if (m_affinityChanged) {
+        pthread_setaffinity_np(pthread_self(), sizeof(m_affinity), &m_affinity);
+        m_affinityChanged = false;
+    }
+}
+
+bool AudioThread::setRealtimePriority(int priority)
+{
+    sched_param parameters;
+    memset(&parameters, 0, sizeof(parameters));
+    parameters.sched_priority = priority;
+
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+    if (!error) {
+        GST_INFO("Render thread running with SCHED_FIFO priority %d", priority);
+        return true;
+    }
+
+    // Unprivileged processes usually have no real-time budget, but rtkit hands it out.
+    if (error == EPERM && makeRealtimeWithRtkit(priority))
+        return true;
+
+    GST_WARNING("Can't make the render thread real-time, running at normal priority: %s", strerror(error));
+    return false;
+}
+
+bool AudioThread::makeRealtimeWithRtkit(int priority)
+{
+    GError* error = 0;
+    GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, 0, &error);
+    if (!connection) {
+        GST_DEBUG("No system bus to reach rtkit: %s", error->message);
+        g_error_free(error);
+        return false;
+    }
+    limitRealtimeCpuTime();
+
+    GVariant* result = g_dbus_connection_call_sync(connection, "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                                   "org.freedesktop.DBus.Properties", "Get",
+                                                   g_variant_new("(ss)", "org.freedesktop.RealtimeKit1", "MaxRealtimePriority"),
+                                                   G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, 0, 0);
+    if (result) {
+        GVariant* value;
+        g_variant_get(result, "(v)", &value);
+        if (g_variant_is_of_type(value, G_VARIANT_TYPE_INT32))
+            priority = MIN(priority, g_variant_get_int32(value));
+        g_variant_unref(value);
+        g_variant_unref(result);
+    }
+
+    guint64 thread = syscall(SYS_gettid);
+    result = g_dbus_connection_call_sync(connection, "org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                         "org.freedesktop.RealtimeKit1", "MakeThreadRealtime",
+                                         g_variant_new("(tu)", thread, static_cast<guint32>(priority)),
+                                         0, G_DBUS_CALL_FLAGS_NONE, -1, 0, &error);
+    g_object_unref(connection);
+
+    if (!result) {
+        GST_DEBUG("rtkit refused to make the render thread real-time: %s", error->message);
+        g_error_free(error);
+        restoreRealtimeCpuTime();
+        return false;
+    }
+    g_variant_unref(result);
+    m_cpuTimeLimited = true;
+    GST_INFO("Render thread made real-time by rtkit with priority %d", priority);
+    return true;
+}
+
+bool AudioThread::lockMemory(const void* address, size_t size)
+{
+    if (!AudioConfig::get().lockMemory || !size)
+        return false;
+
+    if (mlock(address, size)) {
+        GST_WARNING("Can't lock %zu bytes of render buffers: %s", size, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void AudioThread::unlockMemory(const void* address, size_t size)
+{
+    munlock(address, size);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioThread_h
+#define AudioThread_h
+
+#include <cstddef>
+#include <sched.h>
+
+// Puts the thread running the render callback in real-time shape: real-time
+// scheduling, denormals flushed to zero and optionally pinned to a CPU, as
+// configured by AudioConfig. enter() and leave() must be called on the render
+// thread, leave() restores what enter() changed since task threads are pooled.
+class AudioThread
+{
+public:
+    AudioThread();
+
+    void enter();
+    void leave();
+
+    // Keeps the given memory resident so touching it never page faults.
+    static bool lockMemory(const void*, size_t);
+    static void unlockMemory(const void*, size_t);
+
+private:
+    bool setRealtimePriority(int priority);
+    bool makeRealtimeWithRtkit(int priority);
+
+    bool m_schedulingChanged;
+    bool m_cpuTimeLimited;
+    int m_policy;
+    sched_param m_parameters;
+
+    bool m_floatingPointStateChanged;
+    unsigned m_floatingPointState;
+
+    bool m_affinityChanged;
+    cpu_set_t m_affinity;
+};
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DecodedAudioCache.h"
+#include "AudioConfig.h"
+
+#include <NixPlatform/AudioBus.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <glib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+static const uint32_t entryMagic = 0x44415544; // "DUAD"
+static const uint32_t entryVersion = 1;
+static const char entrySuffix[] = ".pcm";
+static const char temporarySuffix[] = ".tmp";
+
+// Temporary files this old were left behind by a process that died while storing.
+static const time_t staleTemporaryAge = 3600;
+
+// Followed by the channels, one after the other.
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t dataSize;
+    float sampleRate;
+    uint32_t channels;
+    uint64_t frames;
+    // Keeps the channel data cache line aligned.
+    uint8_t padding[24];
+};
+static_assert(sizeof(EntryHeader) == 64, "EntryHeader is expected to be 64 bytes");
+
+static inline uint64_t rotateLeft(uint64_t value, unsigned bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline uint64_t read64(const uint8_t* bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t* bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static const uint64_t prime1 = 11400714785074694791ULL;
+static const uint64_t prime2 = 14029467366897019727ULL;
+static const uint64_t prime3 = 1609587929392839161ULL;
+static const uint64_t prime4 = 9650029242287828579ULL;
+static const uint64_t prime5 = 2870177450012600261ULL;
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t input)
+{
+    return rotateLeft(accumulator + input * prime2, 31) * prime1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator)
+{
+    return (hash ^ hashRound(0, accumulator)) * prime1 + prime4;
+}
+
+// xxHash64, several GB/s, so hashing costs little next to even a cache hit.
+static uint64_t hashBytes(const uint8_t* bytes, size_t size)
+{
+    const uint8_t* end = bytes + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t lanes[4] = { prime1 + prime2, prime2, 0, -prime1 };
+        for (; end - bytes >= 32; bytes += 32) {
+            for (unsigned lane = 0; lane < 4; ++lane)
+                lanes[lane] = hashRound(lanes[lane], read64(bytes + 8 * lane));
+        }
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (unsigned lane = 0; lane < 4; ++lane)
+            hash = mergeRound(hash, lanes[lane]);
+    } else
+        hash = prime5;
+
+    hash += size;
+    for (; end - bytes >= 8; bytes += 8)
+        hash = rotateLeft(hash ^ hashRound(0, read64(bytes)), 27) * prime1 + prime4;
+    if (end - bytes >= 4) {
+        hash = rotateLeft(hash ^ (read32(bytes) * prime1), 23) * prime2 + prime3;
+        bytes += 4;
+    }
+    for (; bytes < end; ++bytes)
+        hash = rotateLeft(hash ^ (*bytes * prime5), 11) * prime1;
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static bool hasSuffix(const char* name, const char* suffix)
+{
+    size_t length = strlen(name);
+    size_t suffixLength = strlen(suffix);
+    return length >= suffixLength && !strcmp(name + length - suffixLength, suffix);
+}
+
+DecodedAudioCache* DecodedAudioCache::create()
+{
+    const AudioConfig& config = AudioConfig::get();
+    if (!config.decodeCacheSize)
+        return 0;
+
+    std::string directory = config.decodeCacheDirectory;
+    if (directory.empty()) {
+        gchar* path = g_build_filename(g_get_user_cache_dir(), "drowser", "audio", NULL);
+        directory = path;
+        g_free(path);
+    }
+    if (g_mkdir_with_parents(directory.c_str(), 0700)) {
+        fprintf(stderr, "Not caching decoded audio, can't create %s.\n", directory.c_str());
+        return 0;
+    }
+    return new DecodedAudioCache(directory, static_cast<uint64_t>(config.decodeCacheSize) << 20);
+}
+
+DecodedAudioCache* DecodedAudioCache::get()
+{
+    static DecodedAudioCache* cache = create();
+    return cache;
+}
+
+DecodedAudioCache::DecodedAudioCache(const std::string& directory, uint64_t sizeLimit)
+    : m_directory(directory)
+    , m_sizeLimit(sizeLimit)
+{
+}
+
+DecodedAudioCache::Key DecodedAudioCache::key(const void* data, size_t dataSize, float sampleRate)
+{
+    Key key;
+    key.hash = hashBytes(static_cast<const uint8_t*>(data), dataSize);
+    key.dataSize = dataSize;
+    key.sampleRate = sampleRate;
+    return key;
+}
+
+std::string DecodedAudioCache::path(const Key& key) const
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%016llx-%u%s", static_cast<unsigned long long>(key.hash), static_cast<unsigned>(key.sampleRate), entrySuffix);
+    return m_directory + name;
+}
+
+bool DecodedAudioCache::lookup(const Key& key, Nix::AudioBus* bus) const
+{
+    int fd = open(path(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (!fstat(fd, &status) && static_cast<size_t>(status.st_size) >= sizeof(EntryHeader))
+        memory = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // Another process may have written it, or something else entirely, check
+    // everything before trusting the sizes.
+    const EntryHeader* header = static_cast<const EntryHeader*>(memory);
+    bool valid = header->magic == entryMagic && header->version == entryVersion
+        && header->hash == key.hash && header->dataSize == key.dataSize && header->sampleRate == key.sampleRate
+        && header->channels && header->channels <= 32
+        && header->frames <= (status.st_size - sizeof(EntryHeader)) / sizeof(float) / header->channels
+        && sizeof(EntryHeader) + header->channels * header->frames * sizeof(float) == static_cast<uint64_t>(status.st_size);
+
+    if (valid) {
+        madvise(memory, status.st_size, MADV_SEQUENTIAL);
+        const float* channelData = reinterpret_cast<const float*>(header + 1);
+        bus->initialize(header->channels, header->frames, key.sampleRate);
+        for (unsigned channel = 0; channel < header->channels; ++channel)
+            memcpy(bus->channelData(channel), channelData + channel * header->frames, header->frames * sizeof(float));
+        // The modification time is what trim() goes by.
+        futimens(fd, 0);
+    }
+
+    munmap(memory, status.st_size);
+    close(fd);
+    return valid;
+}
+
+void DecodedAudioCache::store(const Key& key, Nix::AudioBus* bus, unsigned channels, size_t frames)
+{
+    size_t size = sizeof(EntryHeader) + channels * frames * sizeof(float);
+    if (size > m_sizeLimit)
+        return;
+
+    std::string entryPath = path(key);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d%s", getpid(), temporarySuffix);
+    std::string temporaryPath = entryPath + suffix;
+
+    int fd = open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        return;
+
+    void* memory = MAP_FAILED;
+    if (!ftruncate(fd, size))
+        memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        unlink(temporaryPath.c_str());
+        return;
+    }
+
+    EntryHeader* header = static_cast<EntryHeader*>(memory);
+    memset(header, 0, sizeof(EntryHeader));
+    header->magic = entryMagic;
+    header->version = entryVersion;
+    header->hash = key.hash;
+    header->dataSize = key.dataSize;
+    header->sampleRate = key.sampleRate;
+    header->channels = channels;
+    header->frames = frames;
+    float* channelData = reinterpret_cast<float*>(header + 1);
+    for (unsigned channel = 0; channel < channels; ++channel)
+        memcpy(channelData + channel * frames, bus->channelData(channel), frames * sizeof(float));
+    munmap(memory, size);
+
+    // Readers see either no entry or a complete one. Two processes storing
+    // the same file at once write the same thing, whichever wins is fine.
+    if (rename(temporaryPath.c_str(), entryPath.c_str())) {
+        unlink(temporaryPath.c_str());
+        return;
+    }
+
+    trim();
+}
+
+void DecodedAudioCache::trim()
+{
+    DIR* directory = opendir(m_directory.c_str());
+    if (!directory)
+        return;
+
+    // Modification time and size of each entry.
+    std::vector<std::pair<std::pair<time_t, std::string>, uint64_t> > entries;
+    uint64_t totalSize = 0;
+    time_t now = time(0);
+    int directoryFd = dirfd(directory);
+    while (struct dirent* entry = readdir(directory)) {
+        struct stat status;
+        if (fstatat(directoryFd, entry->d_name, &status, AT_SYMLINK_NOFOLLOW) || !S_ISREG(status.st_mode))
+            continue;
+        if (hasSuffix(entry->d_name, temporarySuffix)) {
+            if (now - status.st_mtime > staleTemporaryAge)
+                unlinkat(directoryFd, entry->d_name, 0);
+        } else if (hasSuffix(entry->d_name, entrySuffix)) {
+            entries.push_back(std::make_pair(std::make_pair(status.st_mtime, std::string(entry->d_name)), status.st_size));
+            totalSize += status.st_size;
+        }
+    }
+
+    if (totalSize > m_sizeLimit) {
+        // Down to 90% of the limit, not to come back here on the next store.
+        uint64_t target = m_sizeLimit / 10 * 9;
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < entries.size() && totalSize > target; ++i) {
+            // Processes holding it mapped keep their copy until they unmap it.
+            if (!unlinkat(directoryFd, entries[i].first.second.c_str(), 0))
+                totalSize -= entries[i].second;
+        }
+    }
+
+    closedir(directory);
+}
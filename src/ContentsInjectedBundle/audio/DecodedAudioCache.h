@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DecodedAudioCache_h
+#define DecodedAudioCache_h
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace Nix {
+class AudioBus;
+}
+
+// Decoded audio files, kept in a directory shared by every web process. An
+// entry is the planar float channels of one file at one rate, named after a
+// hash of the encoded bytes, so the same asset is only decoded once however
+// many pages load it. Hits are read through a shared mapping, the page cache
+// holding a single copy for all processes.
+//
+// Entries are written to a temporary file and renamed into place, readers
+// never see a partial one. The directory is trimmed to the configured size
+// after each store, least recently used entries first.
+class DecodedAudioCache {
+public:
+    // 0 when the cache is disabled or its directory can't be created.
+    static DecodedAudioCache* get();
+
+    struct Key {
+        uint64_t hash;
+        uint64_t dataSize;
+        float sampleRate;
+    };
+    static Key key(const void* data, size_t dataSize, float sampleRate);
+
+    // Fills bus and returns true if the entry exists and is sane.
+    bool lookup(const Key&, Nix::AudioBus*) const;
+    void store(const Key&, Nix::AudioBus*, unsigned channels, size_t frames);
+
+private:
+    DecodedAudioCache(const std::string& directory, uint64_t sizeLimit);
+    static DecodedAudioCache* create();
+
+    std::string path(const Key&) const;
+    void trim();
+
+    std::string m_directory;
+    uint64_t m_sizeLimit;
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "EmbeddedResources.h"
+
+#include <cstring>
+
+#ifdef HRTF_DATABASE_PATH
+// Straight into .rodata: mapped from the bundle's file, shared by every web
+// process and never paged in before the first panner needs it.
+__asm__(
+    ".pushsection .rodata.hrtfDatabase, \"a\"\n"
+    ".balign 16\n"
+    ".globl drowserHRTFDatabase\n"
+    ".hidden drowserHRTFDatabase\n"
+    "drowserHRTFDatabase:\n"
+    ".incbin \"" HRTF_DATABASE_PATH "\"\n"
+    ".globl drowserHRTFDatabaseEnd\n"
+    ".hidden drowserHRTFDatabaseEnd\n"
+    "drowserHRTFDatabaseEnd:\n"
+    ".popsection\n");
+
+extern "C" const char drowserHRTFDatabase[];
+extern "C" const char drowserHRTFDatabaseEnd[];
+#endif
+
+namespace EmbeddedResources {
+
+bool find(const char* name, const char*& data, size_t& size)
+{
+#ifdef HRTF_DATABASE_PATH
+    // What HRTFElevation asks for through AudioBus::loadPlatformResource().
+    if (!strcmp(name, "Composite")) {
+        data = drowserHRTFDatabase;
+        size = drowserHRTFDatabaseEnd - drowserHRTFDatabase;
+        return true;
+    }
+#else
+    (void)name;
+    (void)data;
+    (void)size;
+#endif
+    return false;
+}
+
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FFTBufferPool.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace FFTBufferPool {
+
+// More sizes than WebCore uses, blocks of any other size aren't kept.
+static const unsigned maximumSizeClasses = 32;
+// Beyond this, released blocks are freed rather than kept.
+static const size_t maximumCachedBytes = 32 * 1024 * 1024;
+
+struct SizeClass {
+    size_t bytes;
+    std::vector<void*> blocks;
+};
+
+struct Pool {
+    std::mutex mutex;
+    SizeClass classes[maximumSizeClasses];
+    unsigned classCount;
+    size_t cachedBytes;
+};
+
+// Leaked, so frames destroyed after static destructors ran still find it.
+static Pool& pool()
+{
+    static Pool* pool = new Pool();
+    return *pool;
+}
+
+static size_t blockBytes(size_t floats)
+{
+    return (floats * sizeof(float) + alignment - 1) & ~(alignment - 1);
+}
+
+// Called with the pool locked. Returns 0 when bytes has no class and there's no room for one.
+static SizeClass* findSizeClass(Pool& pool, size_t bytes, bool create)
+{
+    for (unsigned i = 0; i < pool.classCount; ++i) {
+        if (pool.classes[i].bytes == bytes)
+            return &pool.classes[i];
+    }
+    if (!create || pool.classCount == maximumSizeClasses)
+        return 0;
+    SizeClass* result = &pool.classes[pool.classCount++];
+    result->bytes = bytes;
+    return result;
+}
+
+float* allocate(size_t floats)
+{
+    size_t bytes = blockBytes(floats);
+    if (bytes / sizeof(float) < floats)
+        throw std::bad_alloc();
+
+    {
+        Pool& blocks = pool();
+        std::lock_guard<std::mutex> lock(blocks.mutex);
+        SizeClass* sizeClass = findSizeClass(blocks, bytes, false);
+        if (sizeClass && !sizeClass->blocks.empty()) {
+            void* block = sizeClass->blocks.back();
+            sizeClass->blocks.pop_back();
+            blocks.cachedBytes -= bytes;
+            return static_cast<float*>(block);
+        }
+    }
+
+    void* block;
+    if (posix_memalign(&block, alignment, bytes))
+        throw std::bad_alloc();
+    return static_cast<float*>(block);
+}
+
+void release(float* data, size_t floats) noexcept
+{
+    if (!data)
+        return;
+
+    size_t bytes = blockBytes(floats);
+    try {
+        Pool& blocks = pool();
+        std::lock_guard<std::mutex> lock(blocks.mutex);
+        if (blocks.cachedBytes + bytes <= maximumCachedBytes) {
+            if (SizeClass* sizeClass = findSizeClass(blocks, bytes, true)) {
+                sizeClass->blocks.push_back(data);
+                blocks.cachedBytes += bytes;
+                return;
+            }
+        }
+    } catch (...) {
+        // Out of memory to keep it, or the mutex is broken. Freeing it is always fine.
+    }
+    free(data);
+}
+
+}
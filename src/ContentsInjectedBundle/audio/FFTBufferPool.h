@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef FFTBufferPool_h
+#define FFTBufferPool_h
+
+#include <cstddef>
+
+// Memory for the arrays of FFT frames. Each frame takes a single block, 64
+// byte aligned so the arrays carved from it start on cache lines, and gives it
+// back when destroyed. Blocks are kept by exact size and handed out again, so
+// pages creating and dropping convolvers don't keep going through malloc.
+// Frames come in the few sizes WebCore uses, and their blocks land just past
+// a power of two, so rounding sizes up would nearly double them. Thread safe.
+namespace FFTBufferPool {
+
+static const size_t alignment = 64;
+
+// Rounds a number of floats up so the next array carved after them stays aligned.
+inline size_t alignedCount(size_t floats)
+{
+    const size_t floatsPerLine = alignment / sizeof(float);
+    return (floats + floatsPerLine - 1) & ~(floatsPerLine - 1);
+}
+
+// Uninitialized. Throws std::bad_alloc like new when out of memory.
+float* allocate(size_t floats);
+// floats is the count given to allocate(). Called from destructors, including
+// static ones, so it never throws and works until the process exits.
+void release(float*, size_t floats) noexcept;
+
+}
+
+#endif
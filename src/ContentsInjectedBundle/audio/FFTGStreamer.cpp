@@ -24,7 +24,8 @@
  */
 
 #include "FFTGStreamer.h"
-#include "PlatformClient.h"
+#include "FFTBufferPool.h"
+#include "VectorMath.h"
 
 #include <glib.h>
 G_BEGIN_DECLS
@@ -36,15 +37,8 @@ G_END_DECLS
 
 using namespace Nix;
 
-Nix::FFTFrame* PlatformClient::createFFTFrame(unsigned fftSize)
-{
-    return new FFTGStreamer(fftSize);
-}
-
-Nix::FFTFrame* PlatformClient::createFFTFrame(const Nix::FFTFrame* frame)
-{
-    return new FFTGStreamer(*frame);
-}
+// The layout conversions treat the complex data as interleaved stereo.
+static_assert(sizeof(GstFFTF32Complex) == 2 * sizeof(float), "GstFFTF32Complex isn't a pair of floats");
 
 unsigned frequencyDomainSize(unsigned fftSize)
 {
@@ -55,13 +49,11 @@ FFTGStreamer::FFTGStreamer(unsigned fftSize)
     : m_fftSize(fftSize)
     , m_frequencyDomainSize(frequencyDomainSize(m_fftSize))
 {
-    m_complexData = new GstFFTF32Complex[m_frequencyDomainSize];
-    m_realData = new float[m_frequencyDomainSize];
-    m_imagData = new float[m_frequencyDomainSize];
+    allocateBuffers();
 
-    int fftLength = gst_fft_next_fast_length(m_fftSize);
-    m_forward = gst_fft_f32_new(fftLength, FALSE);
-    m_inverse = gst_fft_f32_new(fftLength, TRUE);
+    // Not gst_fft_next_fast_length(), the buffers are sized for m_fftSize.
+    m_forward = gst_fft_f32_new(m_fftSize, FALSE);
+    m_inverse = gst_fft_f32_new(m_fftSize, TRUE);
 }
 
 FFTGStreamer::FFTGStreamer(const FFTFrame& frame)
@@ -71,25 +63,17 @@ FFTGStreamer::FFTGStreamer(const FFTFrame& frame)
     m_fftSize = other_frame->m_fftSize;
     m_frequencyDomainSize = other_frame->m_frequencyDomainSize;
 
-    m_complexData = new GstFFTF32Complex[m_frequencyDomainSize];
-    memcpy(m_complexData, other_frame->m_complexData, sizeof(GstFFTF32Complex)*m_frequencyDomainSize);
+    allocateBuffers();
+    memcpy(m_buffer, other_frame->m_buffer, bufferSize() * sizeof(float));
 
-    m_realData = new float[m_frequencyDomainSize];
-    memcpy(m_realData, other_frame->m_realData, sizeof(float)*m_frequencyDomainSize);
-
-    m_imagData = new float[m_frequencyDomainSize];
-    memcpy(m_imagData, other_frame->m_imagData, sizeof(float)*m_frequencyDomainSize);
-
-    int fftLength = gst_fft_next_fast_length(m_fftSize);
-    m_forward = gst_fft_f32_new(fftLength, FALSE);
-    m_inverse = gst_fft_f32_new(fftLength, TRUE);
+    // Not gst_fft_next_fast_length(), the buffers are sized for m_fftSize.
+    m_forward = gst_fft_f32_new(m_fftSize, FALSE);
+    m_inverse = gst_fft_f32_new(m_fftSize, TRUE);
 }
 
 FFTGStreamer::~FFTGStreamer()
 {
-    delete m_complexData;
-    delete m_realData;
-    delete m_imagData;
+    FFTBufferPool::release(m_buffer, bufferSize());
 
     if (m_forward)
         gst_fft_f32_free(m_forward);
@@ -98,6 +82,20 @@ FFTGStreamer::~FFTGStreamer()
         gst_fft_f32_free(m_inverse);
 }
 
+size_t FFTGStreamer::bufferSize() const
+{
+    return FFTBufferPool::alignedCount(2 * m_frequencyDomainSize) + 2 * FFTBufferPool::alignedCount(m_frequencyDomainSize);
+}
+
+void FFTGStreamer::allocateBuffers()
+{
+    // One block for the three arrays, each starting on a cache line.
+    m_buffer = FFTBufferPool::allocate(bufferSize());
+    m_complexData = reinterpret_cast<GstFFTF32Complex*>(m_buffer);
+    m_realData = m_buffer + FFTBufferPool::alignedCount(2 * m_frequencyDomainSize);
+    m_imagData = m_realData + FFTBufferPool::alignedCount(m_frequencyDomainSize);
+}
+
 void FFTGStreamer::doFFT(const float* data)
 {
     gst_fft_f32_fft(m_forward, data, m_complexData);
@@ -113,26 +111,9 @@ void FFTGStreamer::doInverseFFT(float* data)
 
 void FFTGStreamer::multiply(const FFTFrame& frame)
 {
-    // Multiply both frames element-wise. In the ideal case we'd implement this using
-    // optimized SSE2 or ARM instructions.
-
-    const FFTGStreamer* other_frame = static_cast<const FFTGStreamer*>(&frame);
-
-    float* real1P = realData();
-    float* imag1P = imagData();
-
-    const float* real2P = other_frame->realData();
-    const float* imag2P = other_frame->imagData();
-
-    const unsigned framesToProcess = m_frequencyDomainSize;
-
-    for (unsigned i = 0; i < framesToProcess; ++i) {
-        float realResult = real1P[i] * real2P[i] - imag1P[i] * imag2P[i];
-        float imagResult = real1P[i] * imag2P[i] + imag1P[i] * real2P[i];
-
-        real1P[i] = realResult;
-        imag1P[i] = imagResult;
-    }
+    // Multiply both frames element-wise, frame may be of another kind.
+    VectorMath::complexMultiply(m_realData, m_imagData, frame.realData(), frame.imagData(),
+                                m_realData, m_imagData, m_frequencyDomainSize);
 }
 
 unsigned FFTGStreamer::frequencyDomainSampleCount() const
@@ -152,16 +133,12 @@ float* FFTGStreamer::imagData() const
 
 void FFTGStreamer::updatePlanarData()
 {
-    for (unsigned i = 0; i < m_frequencyDomainSize; ++i) {
-        m_realData[i] = m_complexData[i].r;
-        m_imagData[i] = m_complexData[i].i;
-    }
+    float* planar[2] = { m_realData, m_imagData };
+    VectorMath::deinterleave(reinterpret_cast<const float*>(m_complexData), 2, planar, m_frequencyDomainSize);
 }
 
 void FFTGStreamer::updateComplexData()
 {
-    for (unsigned i = 0; i < m_frequencyDomainSize; ++i) {
-        m_complexData[i].r = m_realData[i];
-        m_complexData[i].i = m_imagData[i];
-    }
+    const float* planar[2] = { m_realData, m_imagData };
+    VectorMath::interleave(planar, 2, reinterpret_cast<float*>(m_complexData), m_frequencyDomainSize);
 }
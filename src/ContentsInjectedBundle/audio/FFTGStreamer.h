@@ -53,12 +53,16 @@ private:
 
     void updatePlanarData();
     void updateComplexData();
+    size_t bufferSize() const;
+    void allocateBuffers();
 
     unsigned m_fftSize;
     unsigned m_frequencyDomainSize;
     GstFFTF32* m_forward;
     GstFFTF32* m_inverse;
 
+    // m_complexData, m_realData and m_imagData all live in m_buffer, see allocateBuffers().
+    float* m_buffer;
     GstFFTF32Complex* m_complexData;
     float* m_realData; // Using float while inside WebKit we'd use ArrayFloat
     float* m_imagData;
@@ -1,6 +1,13 @@
 #include "PlatformClient.h"
+#include "AudioConfig.h"
 #include "AudioFileReader.h"
 #include "AudioDestination.h"
+#include "AudioHardware.h"
+#include "AudioMixerClient.h"
+#include "FFTGStreamer.h"
+#include "RealFFT.h"
+#include "ResourceLoader.h"
+#include "SplitFFTFrame.h"
 
 #include <NixPlatform/AudioBus.h>
 
@@ -18,6 +25,29 @@ bool initializeAudioBackend()
     return didInitialize;
 }
 
+// Offline rendering doesn't go near the device, and may run where there's none.
+static const AudioHardware& outputHardware()
+{
+    if (AudioConfig::get().output == AudioConfig::DeviceOutput)
+        return AudioHardware::get();
+    return AudioHardware::unprobed();
+}
+
+float PlatformClient::audioHardwareSampleRate()
+{
+    return outputHardware().sampleRate;
+}
+
+size_t PlatformClient::audioHardwareBufferSize()
+{
+    return outputHardware().bufferSize;
+}
+
+unsigned PlatformClient::audioHardwareOutputChannels()
+{
+    return outputHardware().outputChannels;
+}
+
 bool PlatformClient::loadAudioResource(AudioBus* destinationBus, const char* audioFileData, size_t dataSize, double sampleRate)
 {
     return AudioFileReader(audioFileData, dataSize).createBus(destinationBus, sampleRate);
@@ -25,10 +55,36 @@ bool PlatformClient::loadAudioResource(AudioBus* destinationBus, const char* aud
 
 Data PlatformClient::loadResource(const char* name)
 {
-    return AudioFileReader::loadResource(name);
+    return ResourceLoader::load(name);
 }
 
 AudioDevice* PlatformClient::createAudioDevice(size_t bufferSize, unsigned numberOfInputChannels, unsigned numberOfChannels, double sampleRate, AudioDevice::RenderCallback* renderCallback)
 {
+    // Rendering offline has nothing to do with the mixer and its device.
+    if (AudioConfig::get().output == AudioConfig::DeviceOutput) {
+        if (AudioMixerClient* client = AudioMixerClient::create(bufferSize, numberOfInputChannels, numberOfChannels, sampleRate, renderCallback))
+            return client;
+    }
     return new AudioDestination(bufferSize, numberOfInputChannels, numberOfChannels, sampleRate, renderCallback);
 }
+
+static bool useSplitFFT(unsigned fftSize)
+{
+    // WebKit only asks for powers of two, gst_fft is kept for anything else.
+    return AudioConfig::get().fftBackend == AudioConfig::SplitFFT && RealFFT::isSupportedSize(fftSize);
+}
+
+Nix::FFTFrame* PlatformClient::createFFTFrame(unsigned fftSize)
+{
+    if (useSplitFFT(fftSize))
+        return new SplitFFTFrame(fftSize);
+    return new FFTGStreamer(fftSize);
+}
+
+Nix::FFTFrame* PlatformClient::createFFTFrame(const Nix::FFTFrame* frame)
+{
+    // Same size, same kind of frame.
+    if (useSplitFFT((frame->frequencyDomainSampleCount() - 1) * 2))
+        return new SplitFFTFrame(*static_cast<const SplitFFTFrame*>(frame));
+    return new FFTGStreamer(*frame);
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "RealFFT.h"
+#include "VectorMath.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <utility>
+
+const unsigned RealFFT::minimumSize;
+
+// GCC lowers these to SSE on x86 and NEON on ARM, and to plain floats where
+// neither is available, so the butterflies below are written once for both.
+typedef float Float4 __attribute__((vector_size(16)));
+
+template<typename T> static inline T load(const float*);
+template<> inline float load<float>(const float* source) { return *source; }
+template<> inline Float4 load<Float4>(const float* source)
+{
+    Float4 value;
+    memcpy(&value, source, sizeof(value));
+    return value;
+}
+
+static inline void store(float* destination, float value) { *destination = value; }
+static inline void store(float* destination, Float4 value) { memcpy(destination, &value, sizeof(value)); }
+
+// Two radix-2 stages in one pass over the data: butterflies of span quarter
+// between the elements j, j + quarter and j + 2 quarter, j + 3 quarter, then of
+// span 2 quarter between j, j + 2 quarter and j + quarter, j + 3 quarter. T is
+// float or Float4, doing one or four values of j at once.
+template<typename T>
+static inline void radix4(float* real, float* imag, unsigned quarter, unsigned j, const float* twiddleReal, const float* twiddleImag)
+{
+    float* real0 = real + j;
+    float* real1 = real0 + quarter;
+    float* real2 = real1 + quarter;
+    float* real3 = real2 + quarter;
+    float* imag0 = imag + j;
+    float* imag1 = imag0 + quarter;
+    float* imag2 = imag1 + quarter;
+    float* imag3 = imag2 + quarter;
+
+    T w1r = load<T>(twiddleReal + quarter - 1 + j);
+    T w1i = load<T>(twiddleImag + quarter - 1 + j);
+    T w2r = load<T>(twiddleReal + 2 * quarter - 1 + j);
+    T w2i = load<T>(twiddleImag + 2 * quarter - 1 + j);
+
+    T x0r = load<T>(real0), x0i = load<T>(imag0);
+    T x1r = load<T>(real1), x1i = load<T>(imag1);
+    T x2r = load<T>(real2), x2i = load<T>(imag2);
+    T x3r = load<T>(real3), x3i = load<T>(imag3);
+
+    T tr = w1r * x1r - w1i * x1i;
+    T ti = w1r * x1i + w1i * x1r;
+    T y0r = x0r + tr, y0i = x0i + ti;
+    T y1r = x0r - tr, y1i = x0i - ti;
+    tr = w1r * x3r - w1i * x3i;
+    ti = w1r * x3i + w1i * x3r;
+    T y2r = x2r + tr, y2i = x2i + ti;
+    T y3r = x2r - tr, y3i = x2i - ti;
+
+    tr = w2r * y2r - w2i * y2i;
+    ti = w2r * y2i + w2i * y2r;
+    store(real0, y0r + tr);
+    store(imag0, y0i + ti);
+    store(real2, y0r - tr);
+    store(imag2, y0i - ti);
+
+    // The twiddle of j + quarter in the second stage is the one of j times -i.
+    T ur = w2r * y3r - w2i * y3i;
+    T ui = w2r * y3i + w2i * y3r;
+    store(real1, y1r + ui);
+    store(imag1, y1i - ur);
+    store(real3, y1r - ui);
+    store(imag3, y1i + ur);
+}
+
+static std::mutex planMutex;
+// Weak, so plans go away with their last user. The few sizes WebKit uses are
+// all that piles up in here.
+static std::map<unsigned, std::weak_ptr<const RealFFT> > plans;
+
+std::shared_ptr<const RealFFT> RealFFT::shared(unsigned size)
+{
+    std::lock_guard<std::mutex> lock(planMutex);
+    std::weak_ptr<const RealFFT>& entry = plans[size];
+    std::shared_ptr<const RealFFT> plan = entry.lock();
+    if (!plan) {
+        // Not make_shared, the tables would live as long as the weak pointer.
+        plan = std::shared_ptr<const RealFFT>(new RealFFT(size));
+        entry = plan;
+    }
+    return plan;
+}
+
+RealFFT::RealFFT(unsigned size)
+    : m_size(size)
+    , m_half(size / 2)
+{
+    assert(isSupportedSize(size));
+
+    unsigned bits = 0;
+    while ((1u << bits) < m_half)
+        ++bits;
+    for (unsigned i = 0; i < m_half; ++i) {
+        unsigned reversed = 0;
+        for (unsigned bit = 0; bit < bits; ++bit)
+            reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+        if (i < reversed)
+            m_swaps.push_back(std::make_pair(i, reversed));
+    }
+
+    // Stage with butterflies of span half starts at index half - 1.
+    m_twiddleReal.resize(m_half - 1);
+    m_twiddleImag.resize(m_half - 1);
+    for (unsigned half = 1; half < m_half; half *= 2) {
+        for (unsigned j = 0; j < half; ++j) {
+            double angle = -M_PI * j / half;
+            m_twiddleReal[half - 1 + j] = cos(angle);
+            m_twiddleImag[half - 1 + j] = sin(angle);
+        }
+    }
+
+    m_splitReal.resize(m_half / 2 + 1);
+    m_splitImag.resize(m_half / 2 + 1);
+    for (unsigned k = 0; k <= m_half / 2; ++k) {
+        double angle = -2 * M_PI * k / m_size;
+        m_splitReal[k] = cos(angle);
+        m_splitImag[k] = sin(angle);
+    }
+}
+
+void RealFFT::transform(float* real, float* imag) const
+{
+    for (const std::pair<unsigned, unsigned>& swap : m_swaps) {
+        std::swap(real[swap.first], real[swap.second]);
+        std::swap(imag[swap.first], imag[swap.second]);
+    }
+
+    unsigned span = 1;
+    unsigned stages = 0;
+    while ((1u << stages) < m_half)
+        ++stages;
+    if (stages % 2) {
+        // Odd number of radix-2 stages, the first one has no twiddles.
+        for (unsigned i = 0; i < m_half; i += 2) {
+            float r = real[i + 1];
+            float im = imag[i + 1];
+            real[i + 1] = real[i] - r;
+            imag[i + 1] = imag[i] - im;
+            real[i] += r;
+            imag[i] += im;
+        }
+        span = 2;
+    }
+
+    const float* twiddleReal = &m_twiddleReal[0];
+    const float* twiddleImag = &m_twiddleImag[0];
+    for (; span < m_half; span *= 4) {
+        for (unsigned start = 0; start < m_half; start += 4 * span) {
+            if (span >= 4) {
+                for (unsigned j = 0; j < span; j += 4)
+                    radix4<Float4>(real + start, imag + start, span, j, twiddleReal, twiddleImag);
+            } else {
+                for (unsigned j = 0; j < span; ++j)
+                    radix4<float>(real + start, imag + start, span, j, twiddleReal, twiddleImag);
+            }
+        }
+    }
+}
+
+void RealFFT::forward(const float* input, float* real, float* imag) const
+{
+    // z[n] = x[2n] + i x[2n + 1]
+    float* planar[2] = { real, imag };
+    VectorMath::deinterleave(input, 2, planar, m_half);
+    transform(real, imag);
+
+    // With E and O the transforms of the even and odd samples,
+    // X[k] = E[k] + W^k O[k] and X[half - k] = conj(E[k] - W^k O[k]).
+    float dc = real[0];
+    real[0] = dc + imag[0];
+    real[m_half] = dc - imag[0];
+    imag[0] = imag[m_half] = 0;
+
+    for (unsigned k = 1; k <= m_half / 2; ++k) {
+        unsigned mirror = m_half - k;
+        float evenReal = (real[k] + real[mirror]) * 0.5f;
+        float evenImag = (imag[k] - imag[mirror]) * 0.5f;
+        float oddReal = (imag[k] + imag[mirror]) * 0.5f;
+        float oddImag = (real[mirror] - real[k]) * 0.5f;
+        float tr = m_splitReal[k] * oddReal - m_splitImag[k] * oddImag;
+        float ti = m_splitReal[k] * oddImag + m_splitImag[k] * oddReal;
+        real[k] = evenReal + tr;
+        imag[k] = evenImag + ti;
+        real[mirror] = evenReal - tr;
+        imag[mirror] = ti - evenImag;
+    }
+}
+
+void RealFFT::inverse(float* real, float* imag, float* output) const
+{
+    // The other way around, Z[k] = 2 E[k] + 2i O[k], the factor 2 making up
+    // for transforming half as many points.
+    float dc = real[0];
+    real[0] = dc + real[m_half];
+    imag[0] = dc - real[m_half];
+
+    for (unsigned k = 1; k <= m_half / 2; ++k) {
+        unsigned mirror = m_half - k;
+        float evenReal = real[k] + real[mirror];
+        float evenImag = imag[k] - imag[mirror];
+        float differenceReal = real[k] - real[mirror];
+        float differenceImag = imag[k] + imag[mirror];
+        // O = difference * conj(W^k)
+        float oddReal = differenceReal * m_splitReal[k] + differenceImag * m_splitImag[k];
+        float oddImag = differenceImag * m_splitReal[k] - differenceReal * m_splitImag[k];
+        real[k] = evenReal - oddImag;
+        imag[k] = evenImag + oddReal;
+        real[mirror] = evenReal + oddImag;
+        imag[mirror] = oddReal - evenImag;
+    }
+
+    // Swapping real and imaginary parts turns the forward transform into the inverse one.
+    transform(imag, real);
+
+    const float* planar[2] = { real, imag };
+    VectorMath::interleave(planar, 2, output, m_half);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RealFFT_h
+#define RealFFT_h
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Fourier transform of real signals whose size is a power of two, working
+// directly on split real and imaginary arrays. The N real samples are seen as
+// N/2 complex ones, transformed in place in the spectrum arrays, and the
+// halves of the spectrum untangled afterwards, so no complex buffer is needed.
+// Neither direction is normalized, like gst_fft_f32 and kissfft.
+//
+// A RealFFT only holds tables, it can be used from several threads at once.
+// Frames of the same size share one through shared(), a convolver with a long
+// impulse response creates hundreds of them.
+class RealFFT
+{
+public:
+    // size must be a power of two, at least minimumSize.
+    explicit RealFFT(unsigned size);
+
+    // The process wide plan for size, built on first use and freed along with
+    // the last frame using it. Thread safe.
+    static std::shared_ptr<const RealFFT> shared(unsigned size);
+
+    static const unsigned minimumSize = 4;
+    static bool isSupportedSize(unsigned size) { return size >= minimumSize && !(size & (size - 1)); }
+
+    unsigned size() const { return m_size; }
+
+    // real and imag hold size / 2 + 1 values.
+    void forward(const float* input, float* real, float* imag) const;
+    // Uses real and imag as scratch, they hold garbage when it returns, the way
+    // vDSP_fft_zrip leaves them. The imaginary parts of the DC and Nyquist bins
+    // are ignored.
+    void inverse(float* real, float* imag, float* output) const;
+
+private:
+    void transform(float* real, float* imag) const;
+
+    unsigned m_size;
+    unsigned m_half;
+    // Index pairs swapped by the bit reversal of the complex transform.
+    std::vector<std::pair<unsigned, unsigned> > m_swaps;
+    // Twiddles of every stage of the complex transform, stage by stage.
+    std::vector<float> m_twiddleReal;
+    std::vector<float> m_twiddleImag;
+    // exp(-2 pi i k / size) for k up to size / 4, to untangle the spectrum.
+    std::vector<float> m_splitReal;
+    std::vector<float> m_splitImag;
+};
+
+#endif
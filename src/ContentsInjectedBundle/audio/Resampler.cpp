@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Resampler.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+// More phases than this and the tables stop fitting in the cache.
+static const unsigned maximumPhases = 1024;
+
+struct QualityPreset {
+    unsigned taps; // Per phase, when not downsampling.
+    double cutoff; // Fraction of the lower Nyquist frequency kept.
+    double beta; // Of the Kaiser window.
+};
+
+static const QualityPreset qualityPresets[] = {
+    { 16, 0.85, 6 }, // Fast, about 60dB of stop band rejection.
+    { 32, 0.91, 8.6 }, // Balanced, about 90dB.
+    { 64, 0.95, 11 } // Best, past 110dB.
+};
+
+static unsigned greatestCommonDivisor(unsigned a, unsigned b)
+{
+    while (b) {
+        unsigned remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind, order zero.
+static double besselI0(double x)
+{
+    double sum = 1;
+    double term = 1;
+    for (unsigned k = 1; k < 50 && term > sum * 1e-12; ++k) {
+        double factor = x / (2 * k);
+        term *= factor * factor;
+        sum += term;
+    }
+    return sum;
+}
+
+static std::mutex resamplerMutex;
+static std::map<std::tuple<unsigned, unsigned, int>, std::weak_ptr<const Resampler> > resamplers;
+
+std::shared_ptr<const Resampler> Resampler::shared(unsigned inputRate, unsigned outputRate, Quality quality)
+{
+    std::lock_guard<std::mutex> lock(resamplerMutex);
+    std::weak_ptr<const Resampler>& entry = resamplers[std::make_tuple(inputRate, outputRate, static_cast<int>(quality))];
+    std::shared_ptr<const Resampler> resampler = entry.lock();
+    if (!resampler) {
+        resampler = std::shared_ptr<const Resampler>(new Resampler(inputRate, outputRate, quality));
+        entry = resampler;
+    }
+    return resampler;
+}
+
+bool Resampler::isSupported(unsigned inputRate, unsigned outputRate)
+{
+    if (!inputRate || !outputRate)
+        return false;
+    return outputRate / greatestCommonDivisor(inputRate, outputRate) <= maximumPhases;
+}
+
+Resampler::Resampler(unsigned inputRate, unsigned outputRate, Quality quality)
+{
+    assert(isSupported(inputRate, outputRate));
+
+    unsigned divisor = greatestCommonDivisor(inputRate, outputRate);
+    m_interpolation = outputRate / divisor;
+    m_decimation = inputRate / divisor;
+
+    const QualityPreset& preset = qualityPresets[quality];
+    // In input samples, the cutoff frequency over the input rate.
+    double cutoff = 0.5 * preset.cutoff * std::min(1.0, static_cast<double>(outputRate) / inputRate);
+    // A lower cutoff widens the sinc, keep as many of its lobes.
+    m_taps = preset.taps;
+    if (outputRate < inputRate)
+        m_taps = static_cast<unsigned>(ceil(preset.taps * static_cast<double>(inputRate) / outputRate / 4)) * 4;
+    double halfWidth = m_taps / 2;
+    double windowScale = besselI0(preset.beta);
+
+    m_filters.resize(m_interpolation * m_taps);
+    for (unsigned phase = 0; phase < m_interpolation; ++phase) {
+        float* filter = &m_filters[phase * m_taps];
+        double fraction = static_cast<double>(phase) / m_interpolation;
+        double sum = 0;
+        for (unsigned k = 0; k < m_taps; ++k) {
+            // Distance from the output position to the input sample the tap applies to.
+            double distance = halfWidth - 1 - k + fraction;
+            double x = 2 * cutoff * distance;
+            double sinc = x ? sin(M_PI * x) / (M_PI * x) : 1;
+            double position = distance / halfWidth;
+            double window = std::fabs(position) < 1 ? besselI0(preset.beta * sqrt(1 - position * position)) / windowScale : 0;
+            filter[k] = 2 * cutoff * sinc * window;
+            sum += filter[k];
+        }
+        // Unity gain at DC for every phase, or a constant signal would ripple.
+        for (unsigned k = 0; k < m_taps; ++k)
+            filter[k] /= sum;
+    }
+}
+
+size_t Resampler::outputFrames(size_t inputFrames) const
+{
+    return (static_cast<unsigned long long>(inputFrames) * m_interpolation + m_decimation - 1) / m_decimation;
+}
+
+float Resampler::edgeSample(const float* input, size_t inputFrames, size_t base, unsigned phase) const
+{
+    const float* filter = &m_filters[phase * m_taps];
+    float result = 0;
+    for (unsigned k = 0; k < m_taps; ++k) {
+        // Wraps around below zero and is skipped like the samples past the end.
+        size_t index = base - m_taps / 2 + 1 + k;
+        if (index < inputFrames)
+            result += filter[k] * input[index];
+    }
+    return result;
+}
+
+void Resampler::process(const float* input, size_t inputFrames, float* output) const
+{
+    size_t frames = outputFrames(inputFrames);
+    size_t before = m_taps / 2 - 1;
+    size_t after = m_taps / 2;
+
+    size_t base = 0;
+    unsigned phase = 0;
+    for (size_t n = 0; n < frames; ++n) {
+        if (base >= before && base + after < inputFrames)
+            output[n] = VectorMath::dotProduct(&m_filters[phase * m_taps], input + base - before, m_taps);
+        else
+            output[n] = edgeSample(input, inputFrames, base, phase);
+
+        phase += m_decimation;
+        base += phase / m_interpolation;
+        phase %= m_interpolation;
+    }
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef Resampler_h
+#define Resampler_h
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Polyphase windowed sinc sample rate converter. With the ratio reduced to
+// outputRate / inputRate = L / M, output sample n sits at input position
+// n M / L, which falls on one of L phases between two input samples. Each
+// phase gets its own set of taps, computed once, so producing a sample is a
+// single dot product over the neighbouring input samples.
+//
+// A Resampler only holds tables, it can be used from several threads at once.
+class Resampler
+{
+public:
+    enum Quality {
+        Fast,
+        Balanced,
+        Best
+    };
+
+    Resampler(unsigned inputRate, unsigned outputRate, Quality);
+
+    // The process wide converter for the given rates and quality, built on
+    // first use and freed along with its last user. Thread safe.
+    static std::shared_ptr<const Resampler> shared(unsigned inputRate, unsigned outputRate, Quality);
+
+    // Rates whose reduced ratio needs too many phases, 44100 to 44101 say, are
+    // left to GStreamer.
+    static bool isSupported(unsigned inputRate, unsigned outputRate);
+
+    size_t outputFrames(size_t inputFrames) const;
+
+    // Converts a whole signal, taking it as silent outside of input. output
+    // holds outputFrames(inputFrames) frames.
+    void process(const float* input, size_t inputFrames, float* output) const;
+
+private:
+    float edgeSample(const float* input, size_t inputFrames, size_t base, unsigned phase) const;
+
+    unsigned m_interpolation; // L
+    unsigned m_decimation; // M
+    unsigned m_taps;
+    // Tap k of a phase applies to input sample base - m_taps / 2 + 1 + k.
+    std::vector<float> m_filters;
+};
+
+#endif
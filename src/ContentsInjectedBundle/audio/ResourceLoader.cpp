@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ResourceLoader.h"
+#include "EmbeddedResources.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Nix;
+
+namespace ResourceLoader {
+
+struct Resource {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modificationTime;
+    Data data;
+};
+
+static std::mutex resourceMutex;
+static std::map<std::string, Resource> resources;
+static std::map<std::string, Data> embeddedResources;
+
+static bool isSameFile(const Resource& resource, const struct stat& status)
+{
+    return resource.device == status.st_dev && resource.inode == status.st_ino
+        && resource.size == status.st_size && resource.modificationTime == status.st_mtime;
+}
+
+static bool readFile(int fd, size_t size, Data& data)
+{
+    if (!size) {
+        data = Data();
+        return true;
+    }
+
+    void* memory = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED)
+        return false;
+    madvise(memory, size, MADV_SEQUENTIAL);
+    data = Data(static_cast<const char*>(memory), size);
+    munmap(memory, size);
+    return true;
+}
+
+Data load(const char* path)
+{
+    const char* embeddedData;
+    size_t embeddedSize;
+    if (EmbeddedResources::find(path, embeddedData, embeddedSize)) {
+        std::lock_guard<std::mutex> lock(resourceMutex);
+        std::map<std::string, Data>::iterator cached = embeddedResources.find(path);
+        if (cached == embeddedResources.end())
+            cached = embeddedResources.insert(std::make_pair(std::string(path), Data(embeddedData, embeddedSize))).first;
+        return cached->second;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) || !S_ISREG(status.st_mode)) {
+        fprintf(stderr, "Can't load resource %s: %s\n", path, fd < 0 ? strerror(errno) : "not a regular file");
+        if (fd >= 0)
+            close(fd);
+        return Data();
+    }
+
+    std::lock_guard<std::mutex> lock(resourceMutex);
+    std::map<std::string, Resource>::iterator cached = resources.find(path);
+    if (cached != resources.end() && isSameFile(cached->second, status)) {
+        close(fd);
+        return cached->second.data;
+    }
+
+    Resource resource;
+    if (!readFile(fd, status.st_size, resource.data)) {
+        fprintf(stderr, "Can't load resource %s: %s\n", path, strerror(errno));
+        close(fd);
+        return Data();
+    }
+    resource.device = status.st_dev;
+    resource.inode = status.st_ino;
+    resource.size = status.st_size;
+    resource.modificationTime = status.st_mtime;
+    resources[path] = resource;
+    close(fd);
+    return resource.data;
+}
+
+}
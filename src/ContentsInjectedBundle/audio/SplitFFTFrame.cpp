@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SplitFFTFrame.h"
+#include "FFTBufferPool.h"
+#include "RealFFT.h"
+#include "VectorMath.h"
+
+#include <cstring>
+
+SplitFFTFrame::SplitFFTFrame(unsigned fftSize)
+    : m_fft(RealFFT::shared(fftSize))
+    , m_frequencyDomainSize(fftSize / 2 + 1)
+    , m_realData(FFTBufferPool::allocate(bufferSize()))
+    , m_imagData(m_realData + FFTBufferPool::alignedCount(m_frequencyDomainSize))
+{
+    memset(m_realData, 0, bufferSize() * sizeof(float));
+}
+
+SplitFFTFrame::SplitFFTFrame(const SplitFFTFrame& frame)
+    : Nix::FFTFrame()
+    , m_fft(frame.m_fft)
+    , m_frequencyDomainSize(frame.m_frequencyDomainSize)
+    , m_realData(FFTBufferPool::allocate(bufferSize()))
+    , m_imagData(m_realData + FFTBufferPool::alignedCount(m_frequencyDomainSize))
+{
+    memcpy(m_realData, frame.m_realData, bufferSize() * sizeof(float));
+}
+
+SplitFFTFrame::~SplitFFTFrame()
+{
+    FFTBufferPool::release(m_realData, bufferSize());
+}
+
+size_t SplitFFTFrame::bufferSize() const
+{
+    return 2 * FFTBufferPool::alignedCount(m_frequencyDomainSize);
+}
+
+void SplitFFTFrame::doFFT(const float* data)
+{
+    m_fft->forward(data, m_realData, m_imagData);
+}
+
+void SplitFFTFrame::doInverseFFT(float* data)
+{
+    m_fft->inverse(m_realData, m_imagData, data);
+}
+
+void SplitFFTFrame::multiply(const FFTFrame& frame)
+{
+    VectorMath::complexMultiply(m_realData, m_imagData, frame.realData(), frame.imagData(),
+                                m_realData, m_imagData, m_frequencyDomainSize);
+}
+
+unsigned SplitFFTFrame::frequencyDomainSampleCount() const
+{
+    return m_frequencyDomainSize;
+}
+
+float* SplitFFTFrame::realData() const
+{
+    return m_realData;
+}
+
+float* SplitFFTFrame::imagData() const
+{
+    return m_imagData;
+}
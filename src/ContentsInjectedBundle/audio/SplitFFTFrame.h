@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SplitFFTFrame_h
+#define SplitFFTFrame_h
+
+#include <NixPlatform/Platform.h>
+#include <NixPlatform/FFTFrame.h>
+#include <memory>
+
+class RealFFT;
+
+// FFT frame for power of two sizes, transforming straight into and out of the
+// real and imaginary arrays WebKit works on, see RealFFT. Unlike FFTGStreamer
+// it keeps no interleaved copy of the spectrum and shuffles nothing around.
+class SplitFFTFrame : public Nix::FFTFrame {
+public:
+    SplitFFTFrame(unsigned fftSize);
+    SplitFFTFrame(const SplitFFTFrame& frame);
+    ~SplitFFTFrame();
+
+    virtual void doFFT(const float* data);
+    // Clobbers realData() and imagData(), as the vDSP FFTFrame of WebKit does.
+    virtual void doInverseFFT(float* data);
+    virtual void multiply(const FFTFrame& frame);
+
+    virtual unsigned frequencyDomainSampleCount() const;
+    virtual float* realData() const;
+    virtual float* imagData() const;
+
+private:
+    size_t bufferSize() const;
+
+    std::shared_ptr<const RealFFT> m_fft;
+    unsigned m_frequencyDomainSize;
+    // One block from FFTBufferPool, the imaginary parts follow the real ones.
+    float* m_realData;
+    float* m_imagData;
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "WavDecoder.h"
+#include "AudioConfig.h"
+#include "Resampler.h"
+#include "VectorMath.h"
+
+#include <NixPlatform/AudioBus.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace Nix;
+
+static const uint16_t formatPCM = 1;
+static const uint16_t formatFloat = 3;
+static const uint16_t formatExtensible = 0xfffe;
+
+// Frames converted at once, before being split into the bus channels.
+static const size_t blockFrames = 1024;
+
+static uint16_t readLittleEndian16(const uint8_t* bytes)
+{
+    return bytes[0] | bytes[1] << 8;
+}
+
+static uint32_t readLittleEndian32(const uint8_t* bytes)
+{
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+bool WavDecoder::sniff(const void* data, size_t dataSize)
+{
+    const char* bytes = static_cast<const char*>(data);
+    return dataSize >= 12 && !memcmp(bytes, "RIFF", 4) && !memcmp(bytes + 8, "WAVE", 4);
+}
+
+WavDecoder::WavDecoder(const void* data, size_t dataSize)
+    : m_format(Unsupported)
+    , m_channels(0)
+    , m_sampleRate(0)
+    , m_samples(0)
+    , m_frames(0)
+{
+    if (sniff(data, dataSize))
+        parse(static_cast<const uint8_t*>(data), dataSize);
+}
+
+void WavDecoder::parse(const uint8_t* data, size_t dataSize)
+{
+    const uint8_t* end = data + dataSize;
+    const uint8_t* chunk = data + 12;
+    uint16_t format = 0;
+    uint16_t bitsPerSample = 0;
+    uint16_t blockAlign = 0;
+
+    while (end - chunk >= 8) {
+        uint32_t chunkSize = readLittleEndian32(chunk + 4);
+        const uint8_t* body = chunk + 8;
+        size_t available = end - body;
+
+        if (!memcmp(chunk, "fmt ", 4)) {
+            if (chunkSize < 16 || available < 16)
+                return;
+            format = readLittleEndian16(body);
+            m_channels = readLittleEndian16(body + 2);
+            m_sampleRate = readLittleEndian32(body + 4);
+            blockAlign = readLittleEndian16(body + 12);
+            bitsPerSample = readLittleEndian16(body + 14);
+            // The real format is in the first two bytes of the sub format GUID.
+            if (format == formatExtensible && chunkSize >= 40 && available >= 40)
+                format = readLittleEndian16(body + 24);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (!blockAlign)
+                return;
+            // Streaming writers leave the size at 0 or ~0, take what's there.
+            size_t size = chunkSize && chunkSize <= available ? chunkSize : available;
+            m_samples = body;
+            m_frames = size / blockAlign;
+            break;
+        }
+
+        if (chunkSize > available)
+            return;
+        chunk = body + chunkSize + (chunkSize & 1);
+    }
+
+    if (!m_samples || !m_sampleRate || (m_channels != 1 && m_channels != 2))
+        return;
+
+    if (format == formatPCM && bitsPerSample == 16 && blockAlign == 2 * m_channels)
+        m_format = PCM16;
+    else if (format == formatPCM && bitsPerSample == 24 && blockAlign == 3 * m_channels)
+        m_format = PCM24;
+    else if (format == formatFloat && bitsPerSample == 32 && blockAlign == 4 * m_channels)
+        m_format = Float32;
+}
+
+bool WavDecoder::canDecode(float sampleRate) const
+{
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    // The samples are converted as they lie in memory.
+    return false;
+#endif
+    return m_format != Unsupported && (m_sampleRate == sampleRate || Resampler::isSupported(m_sampleRate, sampleRate));
+}
+
+bool WavDecoder::createBus(AudioBus* destinationBus, float sampleRate) const
+{
+    if (!canDecode(sampleRate))
+        return false;
+
+    if (m_sampleRate == sampleRate) {
+        destinationBus->initialize(2, m_frames, sampleRate);
+        decode(destinationBus->channelData(0), destinationBus->channelData(1));
+        return true;
+    }
+
+    std::shared_ptr<const Resampler> resampler = Resampler::shared(m_sampleRate, sampleRate, AudioConfig::get().resamplerQuality);
+    std::vector<float> decoded(m_channels * m_frames);
+    float* left = &decoded[0];
+    decode(left, m_channels == 2 ? left + m_frames : 0);
+
+    size_t frames = resampler->outputFrames(m_frames);
+    destinationBus->initialize(2, frames, sampleRate);
+    resampler->process(left, m_frames, destinationBus->channelData(0));
+    if (m_channels == 2)
+        resampler->process(left + m_frames, m_frames, destinationBus->channelData(1));
+    else
+        memcpy(destinationBus->channelData(1), destinationBus->channelData(0), frames * sizeof(float));
+    return true;
+}
+
+// Splits the samples into left and right, mono files only fill left when right is null.
+void WavDecoder::decode(float* left, float* right) const
+{
+    float block[blockFrames * 2];
+    for (size_t frame = 0; frame < m_frames; frame += blockFrames) {
+        size_t frames = std::min(blockFrames, m_frames - frame);
+        size_t samples = frames * m_channels;
+        size_t firstSample = frame * m_channels;
+
+        switch (m_format) {
+        case PCM16: {
+            // memcpy rather than a cast, the data chunk isn't necessarily aligned.
+            int16_t aligned[blockFrames * 2];
+            memcpy(aligned, m_samples + 2 * firstSample, samples * sizeof(int16_t));
+            VectorMath::int16ToFloat(aligned, block, samples);
+            break;
+        }
+        case PCM24:
+            VectorMath::int24ToFloat(m_samples + 3 * firstSample, block, samples);
+            break;
+        case Float32:
+            memcpy(block, m_samples + 4 * firstSample, samples * sizeof(float));
+            break;
+        case Unsupported:
+            return;
+        }
+
+        if (m_channels == 2) {
+            float* destinations[2] = { left + frame, right + frame };
+            VectorMath::deinterleave(block, 2, destinations, frames);
+        } else
+            memcpy(left + frame, block, frames * sizeof(float));
+    }
+
+    if (m_channels == 1 && right)
+        memcpy(right, left, m_frames * sizeof(float));
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WavDecoder_h
+#define WavDecoder_h
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace Nix {
+class AudioBus;
+}
+
+// Decodes uncompressed WAV files without going through GStreamer, for the
+// short sound effects pages load by the hundreds. Handles 16 and 24 bit PCM
+// and 32 bit float, mono or stereo, resampled in-tree when the file's rate
+// isn't the context's. Anything else is left to AudioFileReader's pipeline.
+class WavDecoder {
+public:
+    // Parses the headers in place, data has to outlive the decoder.
+    WavDecoder(const void* data, size_t dataSize);
+
+    static bool sniff(const void* data, size_t dataSize);
+
+    bool canDecode(float sampleRate) const;
+    // Stereo, like the GStreamer path: mono files go to both channels.
+    bool createBus(Nix::AudioBus* destinationBus, float sampleRate) const;
+
+private:
+    enum Format {
+        Unsupported,
+        PCM16,
+        PCM24,
+        Float32
+    };
+
+    void parse(const uint8_t* data, size_t dataSize);
+    void decode(float* left, float* right) const;
+
+    Format m_format;
+    unsigned m_channels;
+    unsigned m_sampleRate;
+    const uint8_t* m_samples;
+    size_t m_frames;
+};
+
+#endif
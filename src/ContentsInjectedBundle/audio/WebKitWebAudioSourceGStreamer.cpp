@@ -17,8 +17,11 @@
  */
 
 #include "WebKitWebAudioSourceGStreamer.h"
-
-#include <gst/pbutils/pbutils.h>
+#include "AudioHardware.h"
+#include "AudioRenderStats.h"
+#include "AudioRingBuffer.h"
+#include "AudioThread.h"
+#include "VectorMath.h"
 
 #ifdef GST_API_VERSION_1
 #include <gst/audio/audio.h>
@@ -27,49 +30,108 @@
 #endif
 
 #include <NixPlatform/Platform.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string.h>
 
 typedef struct _WebKitWebAudioSrcClass   WebKitWebAudioSrcClass;
 typedef struct _WebKitWebAudioSourcePrivate WebKitWebAudioSourcePrivate;
 
+// Matches the channel layouts GStreamer knows how to position, see webKitWebAudioGStreamerChannelPositions().
+static const unsigned maximumChannels = 8;
+
+// While the output is suspended for silence, WebCore is woken up this often to
+// render the quanta that are due, see webKitWebAudioSrcRenderSuspended().
+static const std::chrono::milliseconds suspendedRenderInterval(50);
+
 struct _WebKitWebAudioSrc {
-    GstBin parent;
+    GstElement parent;
 
     WebKitWebAudioSourcePrivate* priv;
 };
 
 struct _WebKitWebAudioSrcClass {
-    GstBinClass parentClass;
+    GstElementClass parentClass;
 };
 
 struct _WebKitWebAudioSourcePrivate {
     gfloat sampleRate;
     Nix::AudioDevice::RenderCallback* handler;
     guint framesToPull;
-
-    GstElement* interleave; //FIXME: WILL LEAK!!!
-    GstElement* wavEncoder; //FIXME: WILL LEAK!!!
+    guint channels;
+    AudioRingBuffer* input; // Filled by the capture pipeline of the destination, if any.
 
     GstTask* task;
+    AudioThread thread;
+    AudioRenderStats stats;
+
+    // With a prebuffer, WebCore renders from renderTask into output ahead of time, up to
+    // prebuffer frames, and task only drains it. Without one task renders and pushes
+    // each quantum back to back, so any sink stall blocks rendering.
+    guint prebuffer;
+    GstTask* renderTask;
 #ifdef GST_API_VERSION_1
-    GRecMutex mutex;
+    GRecMutex renderTaskLock;
 #else
-    GStaticRecMutex mutex;
+    GStaticRecMutex renderTaskLock;
 #endif
-
-    GSList* pads; // List of queue sink pads. One queue for each planar audio channel.
-    GstPad* sourcePad; // src pad of the element, interleaved wav data is pushed to it.
+    AudioRingBuffer* output;
+    // Only used to sleep while the ring is full or, when starting, not full enough.
+    std::mutex outputMutex;
+    std::condition_variable outputCondition;
+    std::atomic<bool> flushing;
+
+    // After suspendAfter frames of digital silence, or never when it's 0, the destination
+    // is told to pause the pipeline and the rendering task only wakes up every
+    // suspendedRenderInterval, until a quantum isn't silent. rendering is cleared while
+    // the destination is stopped, so that nothing gets rendered then.
+    guint suspendAfter;
+    guint64 silentFrames;
+    std::atomic<bool> suspended;
+    std::atomic<bool> rendering;
+
+    GstPad* sourcePad; // interleaved float samples are pushed to it from task.
+    GstCaps* caps;
+    bool newStream; // Caps and segment must be sent downstream before the next buffer.
+    guint64 framesRendered;
+
+    // Everything the render loop needs is allocated upfront, so rendering a quantum
+    // doesn't touch the heap once the buffer pool reached its working set. WebCore
+    // renders planar data into channelData, which is then interleaved into the buffer.
+    float* channelData;
+    bool channelDataLocked;
+    const float** channelPointers;
+    float* inputData;
+    float** inputPointers;
+#ifdef GST_API_VERSION_1
+    GstBufferPool* pool;
+#else
+    GstBuffer* buffer;
+#endif
+    Nix::Vector<float*>* sourceData;
+    Nix::Vector<float*>* destinationData;
 };
 
 enum {
     PROP_RATE = 1,
     PROP_HANDLER,
-    PROP_FRAMES
+    PROP_FRAMES,
+    PROP_CHANNELS,
+    PROP_INPUT,
+    PROP_PREBUFFER,
+    PROP_SUSPEND_AFTER
 };
 
 static GstStaticPadTemplate srcTemplate = GST_STATIC_PAD_TEMPLATE("src",
                                                                   GST_PAD_SRC,
                                                                   GST_PAD_ALWAYS,
-                                                                  GST_STATIC_CAPS("audio/x-wav"));
+#ifdef GST_API_VERSION_1
+                                                                  GST_STATIC_CAPS("audio/x-raw, format = (string) " GST_AUDIO_NE(F32) ", layout = (string) interleaved"));
+#else
+                                                                  GST_STATIC_CAPS("audio/x-raw-float, width = (int) 32, endianness = (int) BYTE_ORDER"));
+#endif
 
 GST_DEBUG_CATEGORY_STATIC(webkit_web_audio_src_debug);
 #define GST_CAT_DEFAULT webkit_web_audio_src_debug
@@ -80,23 +142,10 @@ static void webKitWebAudioSrcSetProperty(GObject*, guint propertyId, const GValu
 static void webKitWebAudioSrcGetProperty(GObject*, guint propertyId, GValue*, GParamSpec*);
 static GstStateChangeReturn webKitWebAudioSrcChangeState(GstElement*, GstStateChange);
 static void webKitWebAudioSrcLoop(WebKitWebAudioSrc*);
+static void webKitWebAudioSrcRenderLoop(WebKitWebAudioSrc*);
+static void webKitWebAudioSrcEnterThread(GstTask*, GThread*, gpointer);
+static void webKitWebAudioSrcLeaveThread(GstTask*, GThread*, gpointer);
 
-static GstCaps* getGStreamerMonoAudioCaps(float sampleRate)
-{
-#ifdef GST_API_VERSION_1
-    return gst_caps_new_simple("audio/x-raw", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
-                               "channels", G_TYPE_INT, 1,
-                               "format", G_TYPE_STRING, gst_audio_format_to_string(GST_AUDIO_FORMAT_F32),
-                               "layout", G_TYPE_STRING, "non-interleaved", NULL);
-#else
-    return gst_caps_new_simple("audio/x-raw-float", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
-                               "channels", G_TYPE_INT, 1,
-                               "endianness", G_TYPE_INT, G_BYTE_ORDER,
-                               "width", G_TYPE_INT, 32, NULL);
-#endif
-}
-
-#ifdef GST_API_VERSION_1
 // XXX: From AudioBus.h (we don't have it), neeeded for the next function. Put this in a better place?
 enum {
     ChannelLeft = 0,
@@ -108,46 +157,75 @@ enum {
     ChannelSurroundRight = 5,
 };
 
-// XXX: The whole next function can handle both gstreamer-1.0 and 0.10, which is why it has an #ifdef
-// in the middle of it. It was enclosed in this 'outer' #ifdef because it was not needed in the
-// 0.10 build and hence there was an unused function warning.
-static GstAudioChannelPosition webKitWebAudioGStreamerChannelPosition(int channelIndex)
+// WebCore orders the channels of its busses the way GStreamer expects them: L R for stereo,
+// L R SL SR for quad and L R C LFE SL SR for 5.1. 7.1 appends the side channels to the 5.1 layout.
+// Any other count is sent unpositioned and left for audioconvert to deal with.
+static void webKitWebAudioGStreamerChannelPositions(unsigned channels, GstAudioChannelPosition* positions)
 {
-    GstAudioChannelPosition position = GST_AUDIO_CHANNEL_POSITION_NONE;
-
-    switch (channelIndex) {
-    case ChannelLeft:
-        position = GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT;
-        break;
-    case ChannelRight:
-        position = GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT;
-        break;
-    case ChannelCenter:
-        position = GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER;
-        break;
-    case ChannelLFE:
+    switch (channels) {
+    case 1:
 #ifdef GST_API_VERSION_1
-        position = GST_AUDIO_CHANNEL_POSITION_LFE1;
+        positions[0] = GST_AUDIO_CHANNEL_POSITION_MONO;
 #else
-        position = GST_AUDIO_CHANNEL_POSITION_LFE;
+        positions[0] = GST_AUDIO_CHANNEL_POSITION_FRONT_MONO;
 #endif
-        break;
-    case ChannelSurroundLeft:
-        position = GST_AUDIO_CHANNEL_POSITION_REAR_LEFT;
-        break;
-    case ChannelSurroundRight:
-        position = GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT;
-        break;
+        return;
+    case 2:
+        positions[ChannelLeft] = GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT;
+        positions[ChannelRight] = GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT;
+        return;
+    case 4:
+        positions[ChannelLeft] = GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT;
+        positions[ChannelRight] = GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT;
+        positions[2] = GST_AUDIO_CHANNEL_POSITION_REAR_LEFT;
+        positions[3] = GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT;
+        return;
+    case 6:
+    case 8:
+        positions[ChannelLeft] = GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT;
+        positions[ChannelRight] = GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT;
+        positions[ChannelCenter] = GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER;
+#ifdef GST_API_VERSION_1
+        positions[ChannelLFE] = GST_AUDIO_CHANNEL_POSITION_LFE1;
+#else
+        positions[ChannelLFE] = GST_AUDIO_CHANNEL_POSITION_LFE;
+#endif
+        positions[ChannelSurroundLeft] = GST_AUDIO_CHANNEL_POSITION_REAR_LEFT;
+        positions[ChannelSurroundRight] = GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT;
+        if (channels == 8) {
+            positions[6] = GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT;
+            positions[7] = GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT;
+        }
+        return;
     default:
-        break;
-    };
-
-    return position;
+        for (unsigned i = 0; i < channels; ++i)
+            positions[i] = GST_AUDIO_CHANNEL_POSITION_NONE;
+        return;
+    }
 }
+
+static GstCaps* getGStreamerAudioCaps(float sampleRate, unsigned channels)
+{
+    GstAudioChannelPosition positions[maximumChannels];
+    webKitWebAudioGStreamerChannelPositions(channels, positions);
+
+#ifdef GST_API_VERSION_1
+    GstAudioInfo info;
+    gst_audio_info_set_format(&info, GST_AUDIO_FORMAT_F32, static_cast<int>(sampleRate), channels, positions);
+    return gst_audio_info_to_caps(&info);
+#else
+    GstCaps* caps = gst_caps_new_simple("audio/x-raw-float", "rate", G_TYPE_INT, static_cast<int>(sampleRate),
+                                        "channels", G_TYPE_INT, channels,
+                                        "endianness", G_TYPE_INT, G_BYTE_ORDER,
+                                        "width", G_TYPE_INT, 32, NULL);
+    if (channels > 1)
+        gst_audio_set_channel_positions(gst_caps_get_structure(caps, 0), positions);
+    return caps;
 #endif
+}
 
 #define webkit_web_audio_src_parent_class parent_class
-G_DEFINE_TYPE_WITH_CODE(WebKitWebAudioSrc, webkit_web_audio_src, GST_TYPE_BIN, GST_DEBUG_CATEGORY_INIT(webkit_web_audio_src_debug, \
+G_DEFINE_TYPE_WITH_CODE(WebKitWebAudioSrc, webkit_web_audio_src, GST_TYPE_ELEMENT, GST_DEBUG_CATEGORY_INIT(webkit_web_audio_src_debug, \
                             "webkitwebaudiosrc", \
                             0, \
                             "webaudiosrc element"));
@@ -187,26 +265,32 @@ static void webkit_web_audio_src_class_init(WebKitWebAudioSrcClass* webKitWebAud
                                     PROP_FRAMES,
                                     g_param_spec_uint("frames", "frames",
                                                       "Number of audio frames to pull at each iteration",
-                                                      0, G_MAXUINT8, 128, flags));
+                                                      1, AudioHardware::maximumBufferSize, 128, flags));
 
-    g_type_class_add_private(webKitWebAudioSrcClass, sizeof(WebKitWebAudioSourcePrivate));
-}
+    g_object_class_install_property(objectClass,
+                                    PROP_CHANNELS,
+                                    g_param_spec_uint("channels", "channels",
+                                                      "Number of channels of the destination bus",
+                                                      1, maximumChannels, 2, flags));
 
-static GstPad* webkitGstGhostPadFromStaticTemplate(GstStaticPadTemplate* staticPadTemplate, const gchar* name, GstPad* target)
-{
-    GstPad* pad;
-    GstPadTemplate* padTemplate = gst_static_pad_template_get(staticPadTemplate);
+    g_object_class_install_property(objectClass,
+                                    PROP_INPUT,
+                                    g_param_spec_pointer("input", "input",
+                                                         "AudioRingBuffer the live input is read from", flags));
 
-    if (target)
-        pad = gst_ghost_pad_new_from_template(name, target, padTemplate);
-    else
-        pad = gst_ghost_pad_new_no_target_from_template(name, padTemplate);
+    g_object_class_install_property(objectClass,
+                                    PROP_PREBUFFER,
+                                    g_param_spec_uint("prebuffer", "prebuffer",
+                                                      "Number of frames rendered ahead of the sink from a separate thread, 0 renders from the streaming thread",
+                                                      0, G_MAXUINT16, 0, flags));
 
-//#ifdef GST_API_VERSION_1
-    gst_object_unref(padTemplate);
-//#endif
+    g_object_class_install_property(objectClass,
+                                    PROP_SUSPEND_AFTER,
+                                    g_param_spec_uint("suspend-after", "suspend-after",
+                                                      "Number of frames of digital silence after which the output is suspended, 0 never suspends it",
+                                                      0, G_MAXUINT, 0, flags));
 
-    return pad;
+    g_type_class_add_private(webKitWebAudioSrcClass, sizeof(WebKitWebAudioSourcePrivate));
 }
 
 static void webkit_web_audio_src_init(WebKitWebAudioSrc* src)
@@ -215,20 +299,45 @@ static void webkit_web_audio_src_init(WebKitWebAudioSrc* src)
     src->priv = priv;
     new (priv) WebKitWebAudioSourcePrivate();
 
-    priv->sourcePad = webkitGstGhostPadFromStaticTemplate(&srcTemplate, "src", 0);
+    priv->sourcePad = gst_pad_new_from_static_template(&srcTemplate, "src");
+    gst_pad_use_fixed_caps(priv->sourcePad);
     gst_element_add_pad(GST_ELEMENT(src), priv->sourcePad);
 
     priv->handler = 0;
+    priv->rendering = true;
 
 #ifdef GST_API_VERSION_1
-    g_rec_mutex_init(&priv->mutex);
     priv->task = gst_task_new(reinterpret_cast<GstTaskFunction>(webKitWebAudioSrcLoop), src, 0);
 #else
-    g_static_rec_mutex_init(&priv->mutex);
     priv->task = gst_task_create(reinterpret_cast<GstTaskFunction>(webKitWebAudioSrcLoop), src);
 #endif
 
-    gst_task_set_lock(priv->task, &priv->mutex);
+    // Deactivating the pad takes the stream lock, so it waits for the iteration in progress.
+    gst_task_set_lock(priv->task, GST_PAD_GET_STREAM_LOCK(priv->sourcePad));
+
+#ifdef GST_API_VERSION_1
+    g_rec_mutex_init(&priv->renderTaskLock);
+    priv->renderTask = gst_task_new(reinterpret_cast<GstTaskFunction>(webKitWebAudioSrcRenderLoop), src, 0);
+#else
+    g_static_rec_mutex_init(&priv->renderTaskLock);
+    priv->renderTask = gst_task_create(reinterpret_cast<GstTaskFunction>(webKitWebAudioSrcRenderLoop), src);
+#endif
+    gst_task_set_lock(priv->renderTask, &priv->renderTaskLock);
+}
+
+// The real-time setup goes to whichever task calls WebCore.
+static void webKitWebAudioSrcSetThreadCallbacks(WebKitWebAudioSrc* src, GstTask* task)
+{
+#ifdef GST_API_VERSION_1
+    gst_task_set_enter_callback(task, webKitWebAudioSrcEnterThread, src, 0);
+    gst_task_set_leave_callback(task, webKitWebAudioSrcLeaveThread, src, 0);
+#else
+    GstTaskThreadCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.enter_thread = webKitWebAudioSrcEnterThread;
+    callbacks.leave_thread = webKitWebAudioSrcLeaveThread;
+    gst_task_set_thread_callbacks(task, &callbacks, src, 0);
+#endif
 }
 
 static void webKitWebAudioSrcConstructed(GObject* object)
@@ -236,60 +345,46 @@ static void webKitWebAudioSrcConstructed(GObject* object)
     WebKitWebAudioSrc* src = WEBKIT_WEB_AUDIO_SRC(object);
     WebKitWebAudioSourcePrivate* priv = src->priv;
 
-    priv->interleave = gst_element_factory_make("interleave", 0);
-    priv->wavEncoder = gst_element_factory_make("wavenc", 0);
-
-    if (!priv->interleave) {
-        GST_ERROR_OBJECT(src, "Failed to create interleave");
-        return;
+    priv->caps = getGStreamerAudioCaps(priv->sampleRate, priv->channels);
+    priv->stats.setDeadline(gst_util_uint64_scale_int(priv->framesToPull, GST_SECOND, static_cast<int>(priv->sampleRate)));
+    GST_DEBUG_OBJECT(src, "Rendering %u channels, caps %" GST_PTR_FORMAT, priv->channels, priv->caps);
+
+    priv->channelData = g_new0(float, priv->framesToPull * priv->channels);
+    priv->channelPointers = g_new0(const float*, priv->channels);
+    priv->channelDataLocked = AudioThread::lockMemory(priv->channelData, priv->framesToPull * priv->channels * sizeof(float));
+    if (priv->prebuffer) {
+        // Whole quanta are rendered, and the ring has room for one more while it's at the mark.
+        priv->prebuffer = (priv->prebuffer + priv->framesToPull - 1) / priv->framesToPull * priv->framesToPull;
+        priv->output = new AudioRingBuffer(priv->channels, priv->prebuffer + priv->framesToPull, G_MAXUINT);
+        GST_DEBUG_OBJECT(src, "Rendering %u frames ahead", priv->prebuffer);
     }
-
-    if (!priv->wavEncoder) {
-        GST_ERROR_OBJECT(src, "Failed to create wavenc");
-        return;
+    webKitWebAudioSrcSetThreadCallbacks(src, priv->prebuffer ? priv->renderTask : priv->task);
+
+    priv->sourceData = new Nix::Vector<float*>(static_cast<size_t>(priv->input ? priv->input->channels() : 0));
+    if (priv->input) {
+        unsigned inputChannels = priv->input->channels();
+        priv->inputData = g_new0(float, priv->framesToPull * inputChannels);
+        priv->inputPointers = g_new0(float*, inputChannels);
+        for (unsigned i = 0; i < inputChannels; ++i) {
+            priv->inputPointers[i] = priv->inputData + i * priv->framesToPull;
+            (*priv->sourceData)[i] = priv->inputPointers[i];
+        }
+    }
+    priv->destinationData = new Nix::Vector<float*>(static_cast<size_t>(priv->channels));
+    for (unsigned i = 0; i < priv->channels; ++i) {
+        float* channel = priv->channelData + i * priv->framesToPull;
+        (*priv->destinationData)[i] = channel;
+        priv->channelPointers[i] = channel;
     }
-
-    gst_bin_add_many(GST_BIN(src), priv->interleave, priv->wavEncoder, NULL);
-    gst_element_link_pads_full(priv->interleave, "src", priv->wavEncoder, "sink", GST_PAD_LINK_CHECK_NOTHING);
-
-    // For each channel of the bus create a new upstream branch for interleave, like:
-    // queue ! capsfilter ! audioconvert. which is plugged to a new interleave request sinkpad.
-    // FIXME: user channelIndex < priv->channelsCount instead of just using 2!!!!!!!!!!!
-    for (unsigned channelIndex = 0; channelIndex < 2; channelIndex++) {
-        GstElement* queue = gst_element_factory_make("queue", 0);
-        GstElement* capsfilter = gst_element_factory_make("capsfilter", 0);
-        GstElement* audioconvert = gst_element_factory_make("audioconvert", 0);
-
-        GstCaps* monoCaps = getGStreamerMonoAudioCaps(priv->sampleRate);
 
 #ifdef GST_API_VERSION_1
-        GstAudioInfo info;
-        gst_audio_info_from_caps(&info, monoCaps);
-        GST_AUDIO_INFO_POSITION(&info, 0) = webKitWebAudioGStreamerChannelPosition(channelIndex);
-        GstCaps* caps = gst_audio_info_to_caps(&info);
-        g_object_set(capsfilter, "caps", caps, NULL);
-#else
-        g_object_set(capsfilter, "caps", monoCaps, NULL);
+    // The pool starts with enough buffers for the sink and whatever is in flight
+    // and only grows if downstream holds on to more than that.
+    priv->pool = gst_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(priv->pool);
+    gst_buffer_pool_config_set_params(config, priv->caps, priv->framesToPull * priv->channels * sizeof(float), 4, 0);
+    gst_buffer_pool_set_config(priv->pool, config);
 #endif
-
-        // Configure the queue for minimal latency.
-        g_object_set(queue, "max-size-buffers", static_cast<guint>(1), NULL);
-
-        GstPad* pad = gst_element_get_static_pad(queue, "sink");
-        priv->pads = g_slist_prepend(priv->pads, pad);
-
-        gst_bin_add_many(GST_BIN(src), queue, capsfilter, audioconvert, NULL);
-        gst_element_link_pads_full(queue, "src", capsfilter, "sink", GST_PAD_LINK_CHECK_NOTHING);
-        gst_element_link_pads_full(capsfilter, "src", audioconvert, "sink", GST_PAD_LINK_CHECK_NOTHING);
-        gst_element_link_pads_full(audioconvert, "src", priv->interleave, 0, GST_PAD_LINK_CHECK_NOTHING);
-
-    }
-    priv->pads = g_slist_reverse(priv->pads);
-
-    // wavenc's src pad is the only visible pad of our element.
-    //FIXME: POSSIBLE LEAK!!!
-    GstPad* targetPad = gst_element_get_static_pad(priv->wavEncoder, "src");
-    gst_ghost_pad_set_target(GST_GHOST_PAD(priv->sourcePad), targetPad);
 }
 
 static void webKitWebAudioSrcFinalize(GObject* object)
@@ -297,13 +392,31 @@ static void webKitWebAudioSrcFinalize(GObject* object)
     WebKitWebAudioSrc* src = WEBKIT_WEB_AUDIO_SRC(object);
     WebKitWebAudioSourcePrivate* priv = src->priv;
 
+    gst_object_unref(priv->task);
+    gst_object_unref(priv->renderTask);
 #ifdef GST_API_VERSION_1
-    g_rec_mutex_clear(&priv->mutex);
+    g_rec_mutex_clear(&priv->renderTaskLock);
 #else
-    g_static_rec_mutex_free(&priv->mutex);
+    g_static_rec_mutex_free(&priv->renderTaskLock);
 #endif
-
-    g_slist_free_full(priv->pads, reinterpret_cast<GDestroyNotify>(gst_object_unref));
+    delete priv->output;
+    if (priv->caps)
+        gst_caps_unref(priv->caps);
+#ifdef GST_API_VERSION_1
+    if (priv->pool)
+        gst_object_unref(priv->pool);
+#else
+    if (priv->buffer)
+        gst_buffer_unref(priv->buffer);
+#endif
+    if (priv->channelDataLocked)
+        AudioThread::unlockMemory(priv->channelData, priv->framesToPull * priv->channels * sizeof(float));
+    g_free(priv->channelData);
+    g_free(priv->channelPointers);
+    g_free(priv->inputData);
+    g_free(priv->inputPointers);
+    delete priv->sourceData;
+    delete priv->destinationData;
 
     priv->~WebKitWebAudioSourcePrivate();
     GST_CALL_PARENT(G_OBJECT_CLASS, finalize, ((GObject* )(src)));
@@ -324,6 +437,18 @@ static void webKitWebAudioSrcSetProperty(GObject* object, guint propertyId, cons
     case PROP_FRAMES:
         priv->framesToPull = g_value_get_uint(value);
         break;
+    case PROP_CHANNELS:
+        priv->channels = g_value_get_uint(value);
+        break;
+    case PROP_INPUT:
+        priv->input = static_cast<AudioRingBuffer*>(g_value_get_pointer(value));
+        break;
+    case PROP_PREBUFFER:
+        priv->prebuffer = g_value_get_uint(value);
+        break;
+    case PROP_SUSPEND_AFTER:
+        priv->suspendAfter = g_value_get_uint(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propertyId, pspec);
         break;
@@ -345,12 +470,207 @@ static void webKitWebAudioSrcGetProperty(GObject* object, guint propertyId, GVal
     case PROP_FRAMES:
         g_value_set_uint(value, priv->framesToPull);
         break;
+    case PROP_CHANNELS:
+        g_value_set_uint(value, priv->channels);
+        break;
+    case PROP_INPUT:
+        g_value_set_pointer(value, priv->input);
+        break;
+    case PROP_PREBUFFER:
+        g_value_set_uint(value, priv->prebuffer);
+        break;
+    case PROP_SUSPEND_AFTER:
+        g_value_set_uint(value, priv->suspendAfter);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propertyId, pspec);
         break;
     }
 }
 
+// Task threads come from a pool, so whatever is changed here is undone when the task leaves the thread.
+static void webKitWebAudioSrcEnterThread(GstTask*, GThread*, gpointer userData)
+{
+    WEBKIT_WEB_AUDIO_SRC(userData)->priv->thread.enter();
+}
+
+static void webKitWebAudioSrcLeaveThread(GstTask*, GThread*, gpointer userData)
+{
+    WEBKIT_WEB_AUDIO_SRC(userData)->priv->thread.leave();
+}
+
+static void webKitWebAudioSrcStartStream(WebKitWebAudioSrc* src)
+{
+    WebKitWebAudioSourcePrivate* priv = src->priv;
+
+#ifdef GST_API_VERSION_1
+    gchar* streamId = g_strdup_printf("webaudio/%p", src);
+    gst_pad_push_event(priv->sourcePad, gst_event_new_stream_start(streamId));
+    g_free(streamId);
+
+    gst_pad_set_caps(priv->sourcePad, priv->caps);
+
+    GstSegment segment;
+    gst_segment_init(&segment, GST_FORMAT_TIME);
+    gst_pad_push_event(priv->sourcePad, gst_event_new_segment(&segment));
+#else
+    gst_pad_set_caps(priv->sourcePad, priv->caps);
+    gst_pad_push_event(priv->sourcePad, gst_event_new_new_segment(FALSE, 1.0, GST_FORMAT_TIME, 0, -1, 0));
+#endif
+
+    priv->framesRendered = 0;
+    priv->newStream = false;
+}
+
+#ifdef GST_API_VERSION_1
+static GstBuffer* webKitWebAudioSrcAcquireBuffer(WebKitWebAudioSourcePrivate* priv)
+{
+    // This blocks when the pool is exhausted, and fails once it's deactivated on stop.
+    GstBuffer* buffer;
+    if (gst_buffer_pool_acquire_buffer(priv->pool, &buffer, 0) != GST_FLOW_OK)
+        return 0;
+    return buffer;
+}
+#else
+static GstBuffer* webKitWebAudioSrcAcquireBuffer(WebKitWebAudioSourcePrivate* priv)
+{
+    // Reuse the buffer of the previous iteration once downstream released it.
+    if (!priv->buffer || !gst_buffer_is_writable(priv->buffer)) {
+        if (priv->buffer)
+            gst_buffer_unref(priv->buffer);
+        priv->buffer = gst_buffer_new_and_alloc(priv->framesToPull * priv->channels * sizeof(float));
+        gst_buffer_set_caps(priv->buffer, priv->caps);
+    }
+    return gst_buffer_ref(priv->buffer);
+}
+#endif
+
+// Renders a quantum into the planar channelData.
+static void webKitWebAudioSrcRender(WebKitWebAudioSourcePrivate* priv)
+{
+    uint64_t renderStart = AudioRenderStats::now();
+    if (priv->input)
+        priv->input->read(priv->inputPointers, priv->framesToPull);
+
+    priv->handler->render(*priv->sourceData, *priv->destinationData, priv->framesToPull);
+    priv->stats.recordRender(renderStart, AudioRenderStats::now() - renderStart);
+}
+
+static void webKitWebAudioSrcNotifyOutput(WebKitWebAudioSourcePrivate* priv)
+{
+    std::lock_guard<std::mutex> lock(priv->outputMutex);
+    priv->outputCondition.notify_all();
+}
+
+// Only exact zeros count, anything else may be the quiet start of a sound.
+static bool webKitWebAudioSrcIsSilent(WebKitWebAudioSourcePrivate* priv)
+{
+    return !VectorMath::maximumMagnitude(priv->channelData, priv->framesToPull * priv->channels);
+}
+
+static void webKitWebAudioSrcPostSilence(WebKitWebAudioSrc* src, bool silent)
+{
+    GST_INFO_OBJECT(src, "%s", silent ? "Output is silent, suspending it" : "Output isn't silent anymore, resuming it");
+    GstStructure* structure = gst_structure_new("webkit-web-audio-silence", "silent", G_TYPE_BOOLEAN, silent, NULL);
+    gst_element_post_message(GST_ELEMENT(src), gst_message_new_element(GST_OBJECT(src), structure));
+}
+
+// Called by the rendering task for every quantum it renders at full rate.
+static void webKitWebAudioSrcCountSilence(WebKitWebAudioSrc* src)
+{
+    WebKitWebAudioSourcePrivate* priv = src->priv;
+    if (!priv->suspendAfter)
+        return;
+
+    if (!webKitWebAudioSrcIsSilent(priv)) {
+        priv->silentFrames = 0;
+        return;
+    }
+    priv->silentFrames += priv->framesToPull;
+    if (priv->silentFrames < priv->suspendAfter)
+        return;
+
+    priv->silentFrames = 0;
+    priv->suspended = true;
+    webKitWebAudioSrcPostSilence(src, true);
+}
+
+// Renders while the output is suspended. Every suspendedRenderInterval the quanta due
+// since the suspension are rendered back to back, so the context time keeps up with
+// the wall clock without waking up for each of them. Returns true with the first
+// quantum that isn't silent in channelData, false when flushing.
+static bool webKitWebAudioSrcRenderSuspended(WebKitWebAudioSrc* src)
+{
+    WebKitWebAudioSourcePrivate* priv = src->priv;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point wakeup = start;
+    guint64 framesDone = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(priv->outputMutex);
+            if (!priv->rendering) {
+                // Stopped, the time spent that way isn't made up for.
+                priv->outputCondition.wait(lock, [priv] { return priv->flushing || priv->rendering; });
+                start = wakeup = std::chrono::steady_clock::now();
+                framesDone = 0;
+            }
+            wakeup += suspendedRenderInterval;
+            priv->outputCondition.wait_until(lock, wakeup, [priv] { return priv->flushing || !priv->rendering; });
+            if (priv->flushing)
+                return false;
+            if (!priv->rendering)
+                continue;
+        }
+
+        guint64 elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        guint64 framesDue = gst_util_uint64_scale_int(elapsed, static_cast<int>(priv->sampleRate), GST_SECOND);
+        for (; framesDone + priv->framesToPull <= framesDue; framesDone += priv->framesToPull) {
+            webKitWebAudioSrcRender(priv);
+            if (!webKitWebAudioSrcIsSilent(priv))
+                return true;
+        }
+    }
+}
+
+static void webKitWebAudioSrcResume(WebKitWebAudioSrc* src)
+{
+    src->priv->suspended = false;
+    webKitWebAudioSrcNotifyOutput(src->priv);
+    webKitWebAudioSrcPostSilence(src, false);
+}
+
+static void webKitWebAudioSrcRenderLoop(WebKitWebAudioSrc* src)
+{
+    WebKitWebAudioSourcePrivate* priv = src->priv;
+
+    if (!priv->handler)
+        return;
+
+    if (priv->suspended) {
+        // The quantum that ends the silence goes in the ring before the push loop is woken up.
+        if (!webKitWebAudioSrcRenderSuspended(src))
+            return;
+        priv->output->write(priv->channelPointers, priv->framesToPull);
+        webKitWebAudioSrcResume(src);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(priv->outputMutex);
+        priv->outputCondition.wait(lock, [priv] {
+            return priv->flushing || priv->output->framesAvailable() < priv->prebuffer;
+        });
+        if (priv->flushing)
+            return;
+    }
+
+    webKitWebAudioSrcRender(priv);
+    webKitWebAudioSrcCountSilence(src);
+    priv->output->write(priv->channelPointers, priv->framesToPull);
+    webKitWebAudioSrcNotifyOutput(priv);
+}
+
 static void webKitWebAudioSrcLoop(WebKitWebAudioSrc* src)
 {
     WebKitWebAudioSourcePrivate* priv = src->priv;
@@ -358,49 +678,99 @@ static void webKitWebAudioSrcLoop(WebKitWebAudioSrc* src)
     if (!priv->handler)
         return;
 
-    GSList* channelBufferList = 0;
-    unsigned bufferSize = priv->framesToPull * sizeof(float);
-    float** audioData = (float**) malloc(g_slist_length(priv->pads) * sizeof(float*));
-    for (int i = g_slist_length(priv->pads) - 1; i >= 0; i--) {
-        GstBuffer* channelBuffer = gst_buffer_new_and_alloc(bufferSize);
-        channelBufferList = g_slist_prepend(channelBufferList, channelBuffer);
+    if (priv->newStream) {
+        webKitWebAudioSrcStartStream(src);
+
+        // Let the render task get ahead before the sink starts eating.
+        if (priv->output) {
+            std::unique_lock<std::mutex> lock(priv->outputMutex);
+            priv->outputCondition.wait(lock, [priv] {
+                return priv->flushing || priv->output->framesAvailable() >= priv->prebuffer;
+            });
+        }
+    }
+
+    // Nothing is pushed while the output is suspended. With a prebuffer what's left in
+    // the ring goes first, so the quantum ending the silence has room in it. Without one
+    // this is the rendering task, and that quantum is pushed right away.
+    bool rendered = false;
+    if (priv->suspended) {
+        if (priv->output) {
+            std::unique_lock<std::mutex> lock(priv->outputMutex);
+            priv->outputCondition.wait(lock, [priv] {
+                return priv->flushing || !priv->suspended || priv->output->framesAvailable() >= priv->framesToPull;
+            });
+            if (priv->flushing)
+                return;
+        } else {
+            if (!webKitWebAudioSrcRenderSuspended(src))
+                return;
+            webKitWebAudioSrcResume(src);
+            rendered = true;
+        }
+    }
+
+    GstBuffer* buffer = webKitWebAudioSrcAcquireBuffer(priv);
+    if (!buffer) {
+        gst_task_pause(priv->task);
+        return;
+    }
+
+    // Waiting for a free buffer is downstream back-pressure, not render time.
+    if (!priv->output && !rendered) {
+        webKitWebAudioSrcRender(priv);
+        webKitWebAudioSrcCountSilence(src);
+    }
+
 #ifdef GST_API_VERSION_1
-        GstMapInfo info;
-        gst_buffer_map(channelBuffer, &info, GST_MAP_READ);
-        audioData[i] = reinterpret_cast<float*>(info.data);
-        gst_buffer_unmap(channelBuffer, &info);
+    GstMapInfo info;
+    gst_buffer_map(buffer, &info, GST_MAP_WRITE);
+    float* data = reinterpret_cast<float*>(info.data);
 #else
-        audioData[i] = reinterpret_cast<float*>(GST_BUFFER_DATA(channelBuffer));
+    float* data = reinterpret_cast<float*>(GST_BUFFER_DATA(buffer));
 #endif
-    }
+    if (priv->output) {
+        // Whatever the render task didn't get to in time goes out as silence.
+        size_t framesRead = priv->output->read(data, priv->framesToPull);
+        if (framesRead < priv->framesToPull)
+            priv->stats.recordUnderrun(priv->framesToPull - framesRead);
+        webKitWebAudioSrcNotifyOutput(priv);
+    } else
+        VectorMath::interleave(priv->channelPointers, priv->channels, data, priv->framesToPull);
+#ifdef GST_API_VERSION_1
+    gst_buffer_unmap(buffer, &info);
+#endif
+
+    int rate = static_cast<int>(priv->sampleRate);
+    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale_int(priv->framesRendered, GST_SECOND, rate);
+    priv->framesRendered += priv->framesToPull;
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale_int(priv->framesRendered, GST_SECOND, rate) - GST_BUFFER_TIMESTAMP(buffer);
 
-    // FIXME: store audioData into priv???
-    //const WebVector<float*>& sourceData, const WebVector<float*>& destinationData, size_t numberOfFrames) { };
-    // FIXME: Add support for local/live audio input by passing sourceAudioData.
-    Nix::Vector<float*> sourceDataVector;
-    Nix::Vector<float*> audioDataVector((size_t) 2);
-    audioDataVector[0] = audioData[0];
-    audioDataVector[1] = audioData[1];
-    priv->handler->render(sourceDataVector, audioDataVector, priv->framesToPull);
-
-    for (int i = g_slist_length(priv->pads) - 1; i >= 0; i--) {
-        GstPad* pad = static_cast<GstPad*>(g_slist_nth_data(priv->pads, i));
-        GstBuffer* channelBuffer = static_cast<GstBuffer*>(g_slist_nth_data(channelBufferList, i));
-
-#ifndef GST_API_VERSION_1
-        GstCaps* monoCaps = getGStreamerMonoAudioCaps(priv->sampleRate);
-        GstStructure* structure = gst_caps_get_structure(monoCaps, 0);
-        GstAudioChannelPosition channelPosition = (i == 0) ? GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT : GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT;
-        gst_audio_set_channel_positions(structure, &channelPosition);
-        gst_buffer_set_caps(channelBuffer, monoCaps);
+    uint64_t pushStart = AudioRenderStats::now();
+    GstFlowReturn ret = gst_pad_push(priv->sourcePad, buffer);
+    priv->stats.recordPush(AudioRenderStats::now() - pushStart);
+    if (ret == GST_FLOW_OK)
+        return;
+
+    // Flushing means we're being stopped, anything else is fatal for the stream.
+#ifdef GST_API_VERSION_1
+    if (ret != GST_FLOW_FLUSHING)
+#else
+    if (ret != GST_FLOW_WRONG_STATE)
 #endif
+        GST_ELEMENT_ERROR(src, CORE, PAD, ("Internal WebAudioSrc error"), ("Failed to push buffer: %s", gst_flow_get_name(ret)));
+    gst_task_pause(priv->task);
+}
 
-        GstFlowReturn ret = gst_pad_chain(pad, channelBuffer);
-        if (ret != GST_FLOW_OK)
-            GST_ELEMENT_ERROR(src, CORE, PAD, ("Internal WebAudioSrc error"), ("Failed to push buffer on %s", GST_DEBUG_PAD_NAME(pad)));
-    }
+AudioRenderStats* webkit_web_audio_src_get_render_stats(WebKitWebAudioSrc* src)
+{
+    return &src->priv->stats;
+}
 
-    g_slist_free(channelBufferList);
+void webkit_web_audio_src_set_rendering(WebKitWebAudioSrc* src, bool rendering)
+{
+    src->priv->rendering = rendering;
+    webKitWebAudioSrcNotifyOutput(src->priv);
 }
 
 static GstStateChangeReturn webKitWebAudioSrcChangeState(GstElement* element, GstStateChange transition)
@@ -409,17 +779,17 @@ static GstStateChangeReturn webKitWebAudioSrcChangeState(GstElement* element, Gs
     WebKitWebAudioSrc* src = WEBKIT_WEB_AUDIO_SRC(element);
 
     switch (transition) {
-    case GST_STATE_CHANGE_NULL_TO_READY:
-        if (!src->priv->interleave) {
-            gst_element_post_message(element, gst_missing_element_message_new(element, "interleave"));
-            GST_ELEMENT_ERROR(src, CORE, MISSING_PLUGIN, (0), ("no interleave"));
-            return GST_STATE_CHANGE_FAILURE;
-        }
-        if (!src->priv->wavEncoder) {
-            gst_element_post_message(element, gst_missing_element_message_new(element, "wavenc"));
-            GST_ELEMENT_ERROR(src, CORE, MISSING_PLUGIN, (0), ("no wavenc"));
-            return GST_STATE_CHANGE_FAILURE;
-        }
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        GST_DEBUG_OBJECT(src, "PAUSED->READY");
+        // Wake up the loops if they're waiting for a free buffer or for the ring,
+        // so the pad deactivation done by the parent class can take the stream lock.
+        src->priv->flushing = true;
+        webKitWebAudioSrcNotifyOutput(src->priv);
+        gst_task_pause(src->priv->task);
+        gst_task_pause(src->priv->renderTask);
+#ifdef GST_API_VERSION_1
+        gst_buffer_pool_set_active(src->priv->pool, FALSE);
+#endif
         break;
     default:
         break;
@@ -434,13 +804,28 @@ static GstStateChangeReturn webKitWebAudioSrcChangeState(GstElement* element, Gs
     switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
         GST_DEBUG_OBJECT(src, "READY->PAUSED");
+        src->priv->newStream = true;
+        src->priv->flushing = false;
+        src->priv->suspended = false;
+        src->priv->silentFrames = 0;
+        if (src->priv->output) {
+            src->priv->output->reset();
+            if (!gst_task_start(src->priv->renderTask))
+                returnValue = GST_STATE_CHANGE_FAILURE;
+        }
+#ifdef GST_API_VERSION_1
+        if (!gst_buffer_pool_set_active(src->priv->pool, TRUE))
+            returnValue = GST_STATE_CHANGE_FAILURE;
+        else
+#endif
         if (!gst_task_start(src->priv->task))
             returnValue = GST_STATE_CHANGE_FAILURE;
         break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
-        GST_DEBUG_OBJECT(src, "PAUSED->READY");
         if (!gst_task_join(src->priv->task))
             returnValue = GST_STATE_CHANGE_FAILURE;
+        if (!gst_task_join(src->priv->renderTask))
+            returnValue = GST_STATE_CHANGE_FAILURE;
         break;
     default:
         break;
@@ -21,6 +21,8 @@
 
 #include <gst/gst.h>
 
+class AudioRenderStats;
+
 #define WEBKIT_TYPE_WEB_AUDIO_SRC (webkit_web_audio_src_get_type())
 #define WEBKIT_WEB_AUDIO_SRC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), WEBKIT_TYPE_WEB_AUDIO_SRC, WebKitWebAudioSrc))
 
@@ -28,4 +30,11 @@ typedef struct _WebKitWebAudioSrc WebKitWebAudioSrc;
 
 GType webkit_web_audio_src_get_type();
 
+// Owned by the element, safe to read from any thread.
+AudioRenderStats* webkit_web_audio_src_get_render_stats(WebKitWebAudioSrc*);
+
+// Whether the destination is started. When the element suspended its output because
+// it was silent, it keeps rendering at a low pace only as long as it is.
+void webkit_web_audio_src_set_rendering(WebKitWebAudioSrc*, bool rendering);
+
 #endif
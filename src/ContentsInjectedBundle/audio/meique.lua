@@ -1,7 +1,4 @@
-gstreamer = findPackage("gstreamer-0.10", REQUIRED)
-gstreamerApp = findPackage("gstreamer-app-0.10", REQUIRED)
-gstreamerAudio = findPackage("gstreamer-audio-0.10", REQUIRED)
-gstreamerFft = findPackage("gstreamer-fft-0.10", REQUIRED)
+gio = findPackage("gio-2.0", REQUIRED)
 
 audio = Library:new("audio", STATIC)
 audio:addCustomFlags("-std=c++0x")
@@ -9,12 +6,57 @@ audio:usePackage(gstreamer)
 audio:usePackage(gstreamerApp)
 audio:usePackage(gstreamerAudio)
 audio:usePackage(gstreamerFft)
+audio:usePackage(gio)
 audio:usePackage(nix)
 audio:addIncludePath("..")
+audio:addIncludePath("../../Shared")
 audio:addFiles([[
+    AudioConfig.cpp
+    AudioDecodeWorker.cpp
     AudioDestination.cpp
     AudioFileReader.cpp
+    AudioMixerClient.cpp
+    AudioRenderStats.cpp
+    AudioThread.cpp
+    DecodedAudioCache.cpp
+    EmbeddedResources.cpp
+    FFTBufferPool.cpp
     FFTGStreamer.cpp
     PlatformClientAudio.cpp
+    RealFFT.cpp
+    Resampler.cpp
+    ResourceLoader.cpp
+    SplitFFTFrame.cpp
+    WavDecoder.cpp
     WebKitWebAudioSourceGStreamer.cpp
+
+    ../../Shared/AudioHardware.cpp
+    ../../Shared/AudioMixerProtocol.cpp
+    ../../Shared/AudioRingBuffer.cpp
+    ../../Shared/VectorMath.cpp
 ]])
+
+-- Standalone checks of the audio backend, see tests/CMakeLists.txt.
+audioTests = {
+    "OutputPathTest",
+    "RealFFTTest",
+    "RenderAllocationTest",
+    "ResamplerTest",
+    "SilenceSuspendTest",
+    "VectorMathTest",
+    "WavDecoderTest",
+    "WebAudioSourceTest",
+}
+for _, name in ipairs(audioTests) do
+    local test = Executable:new(name)
+    test:addCustomFlags("-std=c++0x")
+    test:useTarget(audio)
+    test:usePackage(gstreamer)
+    test:usePackage(gstreamerAudio)
+    test:usePackage(gstreamerFft)
+    test:usePackage(nix)
+    test:addIncludePath(".")
+    test:addIncludePath("../../Shared")
+    test:addFiles("tests/"..name..".cpp")
+    addTest(test)
+end
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Compares the raw output path of AudioDestination with the WAV round trip it
+// replaced (DROWSER_AUDIO_WAV_ROUNDTRIP=1), both ending in a fakesink that
+// takes buffers as fast as they come. For each it reports how long a quantum
+// takes from WebCore rendering it to the sink receiving it, the CPU time spent
+// per second of audio, and what the latency query answers.
+
+#include "AudioTest.h"
+#include "WebKitWebAudioSourceGStreamer.h"
+
+#include <NixPlatform/Platform.h>
+#include <algorithm>
+#include <gst/gst.h>
+#include <time.h>
+#include <vector>
+
+static const unsigned frames = 128;
+static const unsigned channels = 2;
+static const double sampleRate = 44100;
+// Ten seconds of audio.
+static const unsigned quantaToPlay = 3446;
+
+// Marks every sample with the number of its quantum, and notes when it was rendered.
+class MarkingCallback : public Nix::AudioDevice::RenderCallback {
+public:
+    MarkingCallback() : rendered(0), renderTimes(quantaToPlay + 64) { }
+
+    virtual void render(Nix::Vector<float*>&, Nix::Vector<float*>& destination, size_t framesToProcess)
+    {
+        unsigned quantum = rendered++;
+        for (size_t channel = 0; channel < destination.size(); ++channel) {
+            for (size_t i = 0; i < framesToProcess; ++i)
+                destination[channel][i] = quantum;
+        }
+        if (quantum < renderTimes.size())
+            renderTimes[quantum] = AudioTest::now();
+    }
+
+    unsigned rendered;
+    std::vector<double> renderTimes;
+};
+
+struct SinkData {
+    MarkingCallback* callback;
+    std::vector<double> delays;
+    gint lastQuantum;
+    bool inOrder;
+};
+
+// The source renders from the streaming thread without a prebuffer, this runs
+// on the same thread right after the quantum went through the pipeline.
+static void handoffCallback(GstElement*, GstBuffer* buffer, GstPad*, SinkData* data)
+{
+    float first;
+#ifdef GST_API_VERSION_1
+    if (gst_buffer_extract(buffer, 0, &first, sizeof(first)) != sizeof(first))
+        return;
+#else
+    if (GST_BUFFER_SIZE(buffer) < sizeof(first))
+        return;
+    first = *reinterpret_cast<const float*>(GST_BUFFER_DATA(buffer));
+#endif
+    gint quantum = static_cast<gint>(first);
+    if (quantum < data->lastQuantum)
+        data->inOrder = false;
+    if (quantum != data->lastQuantum && static_cast<size_t>(quantum) < data->callback->renderTimes.size())
+        data->delays.push_back(AudioTest::now() - data->callback->renderTimes[quantum]);
+    g_atomic_int_set(&data->lastQuantum, quantum);
+}
+
+#ifndef GST_API_VERSION_1
+static void padAddedCallback(GstElement*, GstPad* pad, GstElement* audioConvert)
+{
+    GstPad* sinkPad = gst_element_get_static_pad(audioConvert, "sink");
+    gst_pad_link(pad, sinkPad);
+    gst_object_unref(sinkPad);
+}
+#endif
+
+static double processTime()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void play(bool wavRoundTrip)
+{
+    MarkingCallback callback;
+    SinkData data = { &callback, std::vector<double>(), -1, true };
+    data.delays.reserve(quantaToPlay + 64);
+
+    GstElement* pipeline = gst_pipeline_new(0);
+    GstElement* source = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
+                                                                     "rate", sampleRate,
+                                                                     "handler", &callback,
+                                                                     "frames", frames,
+                                                                     "channels", channels,
+                                                                     "prebuffer", 0, NULL));
+    GstElement* audioConvert = gst_element_factory_make("audioconvert", 0);
+    GstElement* sink = gst_element_factory_make("fakesink", 0);
+    g_object_set(sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(sink, "handoff", G_CALLBACK(handoffCallback), &data);
+    gst_bin_add_many(GST_BIN(pipeline), source, audioConvert, sink, NULL);
+    gst_element_link(audioConvert, sink);
+
+    // The same links AudioDestination makes.
+    if (wavRoundTrip) {
+        GstElement* wavEncoder = gst_element_factory_make("wavenc", 0);
+        GstElement* wavParser = gst_element_factory_make("wavparse", 0);
+        if (!AudioTest::check(wavEncoder && wavParser, "wavenc and wavparse are installed"))
+            return;
+        gst_bin_add_many(GST_BIN(pipeline), wavEncoder, wavParser, NULL);
+        gst_element_link_pads_full(source, "src", wavEncoder, "sink", GST_PAD_LINK_CHECK_NOTHING);
+        gst_element_link_pads_full(wavEncoder, "src", wavParser, "sink", GST_PAD_LINK_CHECK_NOTHING);
+#ifdef GST_API_VERSION_1
+        gst_element_link_pads_full(wavParser, "src", audioConvert, "sink", GST_PAD_LINK_CHECK_NOTHING);
+#else
+        g_signal_connect(wavParser, "pad-added", G_CALLBACK(padAddedCallback), audioConvert);
+#endif
+    } else
+        gst_element_link_pads_full(source, "src", audioConvert, "sink", GST_PAD_LINK_CHECK_NOTHING);
+
+    double cpuStart = processTime();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    for (unsigned i = 0; i < 2000 && g_atomic_int_get(&data.lastQuantum) < static_cast<gint>(quantaToPlay); ++i)
+        g_usleep(5000);
+    double cpuTime = processTime() - cpuStart;
+
+    GstQuery* query = gst_query_new_latency();
+    GstClockTime minLatency = 0;
+    if (gst_element_query(pipeline, query))
+        gst_query_parse_latency(query, 0, &minLatency, 0);
+    gst_query_unref(query);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    AudioTest::check(data.lastQuantum >= static_cast<gint>(quantaToPlay), "the sink gets every quantum");
+    AudioTest::check(data.inOrder, "quanta reach the sink in order");
+    if (data.delays.empty())
+        return;
+
+    std::sort(data.delays.begin(), data.delays.end());
+    double median = data.delays[data.delays.size() / 2];
+    double worst = data.delays[data.delays.size() * 999 / 1000];
+    double audioSeconds = quantaToPlay * frames / sampleRate;
+    printf("%-16s  %8.1fus  %8.1fus  %10.2fms  %6.1fms\n", wavRoundTrip ? "WAV round trip" : "raw",
+           median * 1e6, worst * 1e6, cpuTime / audioSeconds * 1e3, minLatency / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+    printf("render to sink    median     99.9%%  CPU per second  latency query\n");
+    play(false);
+    play(true);
+    return AudioTest::result();
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks RealFFT against a plain DFT computed in double precision, for every
+// power of two size WebCore uses, and checks it keeps the scaling of gst_fft,
+// which Nix::FFTFrame users rely on: neither direction is normalized, so a
+// round trip multiplies by the size. Then times both frame kinds.
+
+#include "AudioTest.h"
+#include "FFTGStreamer.h"
+#include "RealFFT.h"
+#include "SplitFFTFrame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Float rounding grows with log2(size), this leaves room up to 2^15.
+static const double tolerance = 2e-5;
+
+static void fillRandom(std::vector<float>& data)
+{
+    for (float& value : data)
+        value = static_cast<float>(rand()) / RAND_MAX * 2 - 1;
+}
+
+// X[k] = sum of x[n] exp(-2 pi i k n / size), for k up to size / 2.
+static void naiveForward(const std::vector<float>& input, std::vector<double>& real, std::vector<double>& imag)
+{
+    size_t size = input.size();
+    std::vector<double> cosine(size);
+    std::vector<double> sine(size);
+    for (size_t i = 0; i < size; ++i) {
+        cosine[i] = cos(2 * M_PI * i / size);
+        sine[i] = sin(2 * M_PI * i / size);
+    }
+
+    real.assign(size / 2 + 1, 0);
+    imag.assign(size / 2 + 1, 0);
+    for (size_t k = 0; k <= size / 2; ++k) {
+        double sumReal = 0;
+        double sumImag = 0;
+        size_t phase = 0;
+        for (size_t n = 0; n < size; ++n) {
+            sumReal += input[n] * cosine[phase];
+            sumImag -= input[n] * sine[phase];
+            phase = (phase + k) & (size - 1);
+        }
+        real[k] = sumReal;
+        imag[k] = sumImag;
+    }
+}
+
+// Largest difference relative to the largest reference value.
+template<typename Reference>
+static double relativeError(const float* values, const Reference* reference, size_t count)
+{
+    double error = 0;
+    double peak = 0;
+    for (size_t i = 0; i < count; ++i) {
+        error = std::max(error, std::fabs(static_cast<double>(values[i]) - reference[i]));
+        peak = std::max(peak, std::fabs(static_cast<double>(reference[i])));
+    }
+    return peak ? error / peak : error;
+}
+
+static void checkAgainstDFT(unsigned size)
+{
+    const RealFFT fft(size);
+    unsigned bins = size / 2 + 1;
+    std::vector<float> input(size);
+    fillRandom(input);
+
+    std::vector<double> expectedReal, expectedImag;
+    naiveForward(input, expectedReal, expectedImag);
+
+    std::vector<float> real(bins), imag(bins);
+    fft.forward(&input[0], &real[0], &imag[0]);
+    double forwardError = std::max(relativeError(&real[0], &expectedReal[0], bins), relativeError(&imag[0], &expectedImag[0], bins));
+
+    // Back from the exact spectrum, unnormalized: size times the input.
+    for (unsigned k = 0; k < bins; ++k) {
+        real[k] = expectedReal[k];
+        imag[k] = expectedImag[k];
+    }
+    std::vector<float> output(size);
+    fft.inverse(&real[0], &imag[0], &output[0]);
+    std::vector<double> expectedOutput(size);
+    for (unsigned i = 0; i < size; ++i)
+        expectedOutput[i] = static_cast<double>(input[i]) * size;
+    double inverseError = relativeError(&output[0], &expectedOutput[0], size);
+
+    printf("size %5u: forward error %.2g, inverse error %.2g\n", size, forwardError, inverseError);
+    AudioTest::check(forwardError < tolerance, "forward transform matches the DFT");
+    AudioTest::check(inverseError < tolerance, "inverse transform gives size times the input");
+}
+
+// Both frame kinds back Nix::FFTFrame, WebCore can't tell them apart.
+static void checkAgainstGStreamer(unsigned size)
+{
+    std::vector<float> input(size);
+    fillRandom(input);
+
+    SplitFFTFrame split(size);
+    FFTGStreamer gstreamer(size);
+    split.doFFT(&input[0]);
+    gstreamer.doFFT(&input[0]);
+    unsigned bins = split.frequencyDomainSampleCount();
+    AudioTest::check(bins == gstreamer.frequencyDomainSampleCount(), "both frames hold as many bins");
+    double forwardError = std::max(relativeError(split.realData(), gstreamer.realData(), bins),
+                                   relativeError(split.imagData(), gstreamer.imagData(), bins));
+
+    std::vector<float> splitOutput(size), gstreamerOutput(size);
+    split.doInverseFFT(&splitOutput[0]);
+    gstreamer.doInverseFFT(&gstreamerOutput[0]);
+    double inverseError = relativeError(&splitOutput[0], &gstreamerOutput[0], size);
+
+    AudioTest::check(forwardError < tolerance, "forward transform matches gst_fft");
+    AudioTest::check(inverseError < tolerance, "inverse transform matches gst_fft, scaling included");
+}
+
+// Nanoseconds per forward and inverse transform, each frame kind.
+template<typename Frame>
+static double timeRoundTrip(unsigned size)
+{
+    std::vector<float> input(size), output(size);
+    fillRandom(input);
+    Frame frame(size);
+    unsigned iterations = std::max(16u, (1u << 22) / size);
+    double start = AudioTest::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        frame.doFFT(&input[0]);
+        frame.doInverseFFT(&output[0]);
+    }
+    return (AudioTest::now() - start) * 1e9 / iterations;
+}
+
+int main()
+{
+    // A constant signal only has a DC bin, of size times the constant.
+    {
+        const RealFFT fft(1024);
+        std::vector<float> ones(1024, 1), real(513), imag(513);
+        fft.forward(&ones[0], &real[0], &imag[0]);
+        AudioTest::check(std::fabs(real[0] - 1024) < 1e-3, "forward transform isn't normalized");
+    }
+
+    for (unsigned size = 1 << 7; size <= 1 << 15; size <<= 1) {
+        checkAgainstDFT(size);
+        checkAgainstGStreamer(size);
+    }
+
+    printf("\nround trip    RealFFT    gst_fft\n");
+    for (unsigned size = 1 << 7; size <= 1 << 15; size <<= 1) {
+        double split = timeRoundTrip<SplitFFTFrame>(size);
+        double gstreamer = timeRoundTrip<FFTGStreamer>(size);
+        printf("size %5u  %7.0fns  %7.0fns  %.2fx\n", size, split, gstreamer, gstreamer / split);
+    }
+    return AudioTest::result();
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks the Web Audio render loop doesn't allocate once it's warmed up: the
+// source plays into a fakesink as fast as it can, with and without a
+// prebuffer, while every malloc of the process is counted.
+
+#include "AudioTest.h"
+#include "WebKitWebAudioSourceGStreamer.h"
+
+#include <NixPlatform/Platform.h>
+#include <atomic>
+#include <errno.h>
+#include <gst/gst.h>
+
+// glibc's own entry points, the ones below stand in for them process wide.
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
+
+static std::atomic<bool> counting(false);
+static std::atomic<unsigned> allocations(0);
+
+static inline void countAllocation()
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void* malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* data, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(data, size);
+}
+
+extern "C" int posix_memalign(void** data, size_t alignment, size_t size)
+{
+    countAllocation();
+    *data = __libc_memalign(alignment, size);
+    return *data ? 0 : ENOMEM;
+}
+
+static const unsigned frames = 128;
+static const unsigned channels = 2;
+// The buffer pool grows to what downstream holds on to, then stays there.
+static const unsigned warmUpQuanta = 1000;
+static const unsigned countedQuanta = 20000;
+
+class ToneCallback : public Nix::AudioDevice::RenderCallback {
+public:
+    ToneCallback() : quanta(0) { }
+
+    virtual void render(Nix::Vector<float*>&, Nix::Vector<float*>& destination, size_t framesToProcess)
+    {
+        for (size_t channel = 0; channel < destination.size(); ++channel) {
+            for (size_t i = 0; i < framesToProcess; ++i)
+                destination[channel][i] = (i & 1) ? 0.5f : -0.5f;
+        }
+        quanta.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<unsigned> quanta;
+};
+
+static void waitForQuanta(ToneCallback& callback, unsigned count)
+{
+    for (unsigned i = 0; i < 10000 && callback.quanta.load() < count; ++i)
+        g_usleep(1000);
+}
+
+static void play(unsigned prebuffer)
+{
+    ToneCallback callback;
+    GstElement* source = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
+                                                                     "rate", 48000.0,
+                                                                     "handler", &callback,
+                                                                     "frames", frames,
+                                                                     "channels", channels,
+                                                                     "prebuffer", prebuffer, NULL));
+    GstElement* sink = gst_element_factory_make("fakesink", 0);
+    g_object_set(sink, "sync", FALSE, "silent", TRUE, NULL);
+    GstElement* pipeline = gst_pipeline_new(0);
+    gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
+    gst_element_link(source, sink);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    waitForQuanta(callback, warmUpQuanta);
+    unsigned start = callback.quanta.load();
+    allocations = 0;
+    counting = true;
+    waitForQuanta(callback, start + countedQuanta);
+    counting = false;
+    unsigned rendered = callback.quanta.load() - start;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    printf("prebuffer %u: %u allocations over %u quanta\n", prebuffer, allocations.load(), rendered);
+    AudioTest::check(rendered >= countedQuanta, "the source renders");
+    AudioTest::check(!allocations, "rendering doesn't allocate once warmed up");
+}
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+    play(0);
+    play(2 * frames);
+    return AudioTest::result();
+}
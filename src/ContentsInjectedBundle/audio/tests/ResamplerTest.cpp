@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Measures how cleanly Resampler converts a 1 kHz tone between the usual
+// rates at each quality, and how fast, with and without the runtime picked
+// dot product. Then compares WAV files decoded at another rate in-tree and
+// through the GStreamer pipeline, which resamples with audioresample.
+
+#include "AudioFileReader.h"
+#include "AudioTest.h"
+#include "Resampler.h"
+#include "VectorMath.h"
+#include "WavDecoder.h"
+
+#include <NixPlatform/AudioBus.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <gst/gst.h>
+#include <stdint.h>
+#include <vector>
+
+static const double toneFrequency = 1000;
+static const double toneAmplitude = 0.5;
+
+static const char* qualityNames[] = { "fast", "balanced", "best" };
+// The stop band rejection of each quality, less a little. Upsampling 2x puts
+// the image of the tone closest to the cutoff, that's where it's the lowest.
+static const double minimumSNR[] = { 58, 84, 105 };
+
+struct Rates {
+    unsigned input;
+    unsigned output;
+};
+
+static const Rates rates[] = {
+    { 48000, 44100 },
+    { 44100, 48000 },
+    { 22050, 44100 },
+    { 96000, 44100 }
+};
+
+static std::vector<float> tone(unsigned sampleRate, size_t frames)
+{
+    std::vector<float> samples(frames);
+    for (size_t i = 0; i < frames; ++i)
+        samples[i] = toneAmplitude * sin(2 * M_PI * toneFrequency * i / sampleRate);
+    return samples;
+}
+
+// Against the tone computed at the output rate, leaving out the edges where
+// the filter reaches past the signal.
+static double signalToNoise(const float* output, size_t frames, unsigned sampleRate)
+{
+    const size_t edge = 512;
+    double signal = 0;
+    double noise = 0;
+    for (size_t i = edge; i + edge < frames; ++i) {
+        double expected = toneAmplitude * sin(2 * M_PI * toneFrequency * i / sampleRate);
+        signal += expected * expected;
+        noise += (output[i] - expected) * (output[i] - expected);
+    }
+    return noise ? 10 * log10(signal / noise) : 200;
+}
+
+static void checkQuality(const Rates& rate, Resampler::Quality quality)
+{
+    Resampler resampler(rate.input, rate.output, quality);
+    std::vector<float> input = tone(rate.input, rate.input);
+    size_t frames = resampler.outputFrames(input.size());
+    AudioTest::check(frames == rate.output, "a second of input gives a second of output");
+
+    std::vector<float> output(frames);
+    resampler.process(&input[0], input.size(), &output[0]);
+    double snr = signalToNoise(&output[0], frames, rate.output);
+    printf("%5u to %5u, %-8s  SNR %5.1fdB\n", rate.input, rate.output, qualityNames[quality], snr);
+    AudioTest::check(snr >= minimumSNR[quality], "the tone comes out clean");
+}
+
+// Output frames per second, in millions, of the fastest of a few runs.
+static double throughput(const Resampler& resampler, const std::vector<float>& input, std::vector<float>& output)
+{
+    double fastest = HUGE_VAL;
+    for (unsigned i = 0; i < 20; ++i) {
+        double start = AudioTest::now();
+        resampler.process(&input[0], input.size(), &output[0]);
+        fastest = std::min(fastest, AudioTest::now() - start);
+    }
+    return output.size() / fastest / 1e6;
+}
+
+// A mono float32 file, so the samples aren't quantized before resampling.
+static std::vector<uint8_t> floatWav(const std::vector<float>& samples, unsigned sampleRate)
+{
+    uint32_t dataSize = samples.size() * sizeof(float);
+    const uint32_t header[] = {
+        0x46464952, 36 + dataSize, 0x45564157, // RIFF, size, WAVE
+        0x20746d66, 16, 3 | 1 << 16, sampleRate, sampleRate * 4, 4 | 32 << 16, // "fmt ", float, mono, 32 bits
+        0x61746164, dataSize // data
+    };
+    std::vector<uint8_t> bytes(sizeof(header) + dataSize);
+    memcpy(&bytes[0], header, sizeof(header));
+    memcpy(&bytes[sizeof(header)], &samples[0], dataSize);
+    return bytes;
+}
+
+int main(int argc, char** argv)
+{
+    // Read by AudioConfig the first time it's needed: send plain WAV files
+    // through the pipeline, and don't let the decode cache answer for it.
+    setenv("DROWSER_AUDIO_WAV_DECODER", "0", 1);
+    setenv("DROWSER_AUDIO_CACHE_SIZE", "0", 1);
+    gst_init(&argc, &argv);
+
+    AudioTest::check(!Resampler::isSupported(44100, 44101), "ratios needing too many phases are left to GStreamer");
+    for (const Rates& rate : rates) {
+        AudioTest::check(Resampler::isSupported(rate.input, rate.output), "usual rates are supported");
+        for (int quality = Resampler::Fast; quality <= Resampler::Best; ++quality)
+            checkQuality(rate, static_cast<Resampler::Quality>(quality));
+    }
+
+    printf("\n48000 to 44100   M frames/s  baseline  widest\n");
+    std::vector<float> input = tone(48000, 48000);
+    for (int quality = Resampler::Fast; quality <= Resampler::Best; ++quality) {
+        Resampler resampler(48000, 44100, static_cast<Resampler::Quality>(quality));
+        std::vector<float> output(resampler.outputFrames(input.size()));
+        VectorMath::useBaselineInstructionsOnly(true);
+        double baseline = throughput(resampler, input, output);
+        VectorMath::useBaselineInstructionsOnly(false);
+        double widest = throughput(resampler, input, output);
+        printf("%-8s                     %6.1f  %6.1f\n", qualityNames[quality], baseline, widest);
+    }
+
+    // What AudioFileReader did with these files before WavDecoder resampled them.
+    std::vector<uint8_t> file = floatWav(input, 48000);
+    Nix::AudioBus inTree;
+    Nix::AudioBus gstreamer;
+    double start = AudioTest::now();
+    WavDecoder(&file[0], file.size()).createBus(&inTree, 44100);
+    double inTreeTime = AudioTest::now() - start;
+    start = AudioTest::now();
+    bool decoded = AudioFileReader(&file[0], file.size()).createBus(&gstreamer, 44100);
+    double gstreamerTime = AudioTest::now() - start;
+    AudioTest::check(decoded, "GStreamer decodes the file");
+    AudioTest::check(inTree.length() == 44100, "WavDecoder resamples the whole file");
+    if (decoded && gstreamer.length() >= 44100) {
+        printf("\na second at 48000 decoded at 44100\n"
+               "WavDecoder  %6.0fus  SNR %5.1fdB\n"
+               "GStreamer   %6.0fus  SNR %5.1fdB (the first pipeline run loads the plugins)\n",
+               inTreeTime * 1e6, signalToNoise(inTree.channelData(0), 44100, 44100),
+               gstreamerTime * 1e6, signalToNoise(gstreamer.channelData(0), 44100, 44100));
+    }
+    return AudioTest::result();
+}
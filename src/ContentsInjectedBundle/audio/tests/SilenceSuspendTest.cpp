@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Plays the Web Audio source into a sink synced to the clock, like a device,
+// and checks that once WebCore renders silence for suspend-after frames the
+// source stops pushing and wakes up far less often while still rendering
+// every quantum in time, then resumes with the first one that isn't silent.
+
+#include "AudioTest.h"
+#include "WebKitWebAudioSourceGStreamer.h"
+
+#include <NixPlatform/Platform.h>
+#include <atomic>
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+static const unsigned frames = 128;
+static const unsigned channels = 2;
+static const double sampleRate = 44100;
+// A fifth of a second of silence suspends the output.
+static const unsigned suspendAfter = 8820;
+static const double measuredSeconds = 2;
+
+class SwitchableCallback : public Nix::AudioDevice::RenderCallback {
+public:
+    SwitchableCallback() : silent(false), quanta(0) { }
+
+    virtual void render(Nix::Vector<float*>&, Nix::Vector<float*>& destination, size_t framesToProcess)
+    {
+        float value = silent ? 0 : 0.25f;
+        for (size_t channel = 0; channel < destination.size(); ++channel) {
+            for (size_t i = 0; i < framesToProcess; ++i)
+                destination[channel][i] = value;
+        }
+        quanta++;
+    }
+
+    std::atomic<bool> silent;
+    std::atomic<unsigned> quanta;
+};
+
+static void handoffCallback(GstElement*, GstBuffer*, GstPad*, gint* buffers)
+{
+    g_atomic_int_inc(buffers);
+}
+
+// Times any thread of the process went to sleep, each one a wakeup later.
+static long voluntarySwitches()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw;
+}
+
+// Whether the source posted it went silent, or not, within timeout seconds.
+static bool waitForSilenceMessage(GstBus* bus, bool silent, double timeout)
+{
+    double deadline = AudioTest::now() + timeout;
+    while (AudioTest::now() < deadline) {
+        GstMessage* message = gst_bus_timed_pop_filtered(bus, 10 * GST_MSECOND, GST_MESSAGE_ELEMENT);
+        if (!message)
+            continue;
+        const GstStructure* structure = gst_message_get_structure(message);
+        gboolean messageSilent;
+        bool found = gst_structure_has_name(structure, "webkit-web-audio-silence")
+            && gst_structure_get_boolean(structure, "silent", &messageSilent) && static_cast<bool>(messageSilent) == silent;
+        gst_message_unref(message);
+        if (found)
+            return true;
+    }
+    return false;
+}
+
+struct Measure {
+    double wakeupsPerSecond;
+    unsigned quanta;
+    gint buffers;
+};
+
+static Measure measure(SwitchableCallback& callback, gint* buffers)
+{
+    long switches = voluntarySwitches();
+    unsigned quanta = callback.quanta;
+    gint pushed = g_atomic_int_get(buffers);
+    g_usleep(measuredSeconds * G_USEC_PER_SEC);
+    Measure result = { (voluntarySwitches() - switches) / measuredSeconds, callback.quanta - quanta, g_atomic_int_get(buffers) - pushed };
+    return result;
+}
+
+static void play(unsigned prebuffer)
+{
+    SwitchableCallback callback;
+    gint buffers = 0;
+    GstElement* source = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
+                                                                     "rate", sampleRate,
+                                                                     "handler", &callback,
+                                                                     "frames", frames,
+                                                                     "channels", channels,
+                                                                     "prebuffer", prebuffer,
+                                                                     "suspend-after", suspendAfter, NULL));
+    GstElement* sink = gst_element_factory_make("fakesink", 0);
+    g_object_set(sink, "sync", TRUE, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(sink, "handoff", G_CALLBACK(handoffCallback), &buffers);
+    GstElement* pipeline = gst_pipeline_new(0);
+    gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
+    gst_element_link(source, sink);
+    GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    g_usleep(G_USEC_PER_SEC / 2);
+    Measure playing = measure(callback, &buffers);
+
+    callback.silent = true;
+    bool suspended = waitForSilenceMessage(bus, true, 1);
+    AudioTest::check(suspended, "the source posts it went silent");
+    Measure silent = measure(callback, &buffers);
+
+    callback.silent = false;
+    double resumeStart = AudioTest::now();
+    bool resumed = waitForSilenceMessage(bus, false, 1);
+    double resumeTime = AudioTest::now() - resumeStart;
+    AudioTest::check(resumed, "the source posts it isn't silent anymore");
+    gint buffersBefore = g_atomic_int_get(&buffers);
+    g_usleep(G_USEC_PER_SEC / 5);
+    AudioTest::check(g_atomic_int_get(&buffers) > buffersBefore, "the source pushes again once resumed");
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+
+    double quantaDue = measuredSeconds * sampleRate / frames;
+    printf("prebuffer %4u  playing: %6.1f wakeups/s, %4u quanta  suspended: %5.1f wakeups/s, %4u quanta, %d buffers  resumed in %.0fms\n",
+           prebuffer, playing.wakeupsPerSecond, playing.quanta, silent.wakeupsPerSecond, silent.quanta, silent.buffers, resumeTime * 1e3);
+    if (!suspended)
+        return;
+    AudioTest::check(!silent.buffers, "nothing is pushed while suspended");
+    // One burst late at most, at either end of the measurement.
+    AudioTest::check(silent.quanta > quantaDue * 0.9 && silent.quanta < quantaDue * 1.1, "quanta are still rendered in time while suspended");
+    AudioTest::check(silent.wakeupsPerSecond * 4 < playing.wakeupsPerSecond, "the suspended source wakes up far less often");
+    AudioTest::check(resumeTime < 0.2, "the source resumes within a burst");
+}
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+    play(0);
+    play(2 * frames);
+    return AudioTest::result();
+}
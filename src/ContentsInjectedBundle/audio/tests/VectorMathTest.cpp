@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Checks the VectorMath kernels against the scalar loops they replaced, on
+// every size up to a few vectors so all the tails are covered, with and
+// without the paths picked at runtime. Then times the three of them.
+
+#include "AudioTest.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char* widestInstructions = "AVX2";
+static const char* baselineInstructions = "SSE2";
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+static const char* widestInstructions = "NEON";
+static const char* baselineInstructions = "NEON";
+#else
+static const char* widestInstructions = "scalar";
+static const char* baselineInstructions = "scalar";
+#endif
+
+static float randomSample()
+{
+    return static_cast<float>(rand()) / RAND_MAX * 2 - 1;
+}
+
+// A kernel and the scalar loop it replaced, run on the same random data. Each
+// one leaves its results in output, which has to be the same unless the
+// kernel sums in another order.
+struct Kernel {
+    const char* name;
+    void (*prepare)(size_t count);
+    void (*scalar)(size_t count);
+    void (*vectorized)(size_t count);
+    float tolerance;
+};
+
+static std::vector<float> inputs[4];
+static std::vector<float> output[2];
+
+static void prepareFloats(size_t count)
+{
+    for (std::vector<float>& input : inputs) {
+        input.resize(2 * count + 1);
+        std::generate(input.begin(), input.end(), randomSample);
+    }
+    for (std::vector<float>& data : output)
+        data.assign(2 * count + 1, 0);
+}
+
+// What FFTGStreamer::multiply did.
+static void complexMultiplyScalar(size_t count)
+{
+    const float* realA = &inputs[0][0];
+    const float* imagA = &inputs[1][0];
+    const float* realB = &inputs[2][0];
+    const float* imagB = &inputs[3][0];
+    for (size_t i = 0; i < count; ++i) {
+        output[0][i] = realA[i] * realB[i] - imagA[i] * imagB[i];
+        output[1][i] = realA[i] * imagB[i] + imagA[i] * realB[i];
+    }
+}
+
+static void complexMultiply(size_t count)
+{
+    VectorMath::complexMultiply(&inputs[0][0], &inputs[1][0], &inputs[2][0], &inputs[3][0], &output[0][0], &output[1][0], count);
+}
+
+// What FFTGStreamer::updateComplexData did.
+static void interleaveScalar(size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        output[0][2 * i] = inputs[0][i];
+        output[0][2 * i + 1] = inputs[1][i];
+    }
+}
+
+static void interleave(size_t count)
+{
+    const float* planar[2] = { &inputs[0][0], &inputs[1][0] };
+    VectorMath::interleave(planar, 2, &output[0][0], count);
+}
+
+// What FFTGStreamer::updatePlanarData did.
+static void deinterleaveScalar(size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        output[0][i] = inputs[0][2 * i];
+        output[1][i] = inputs[0][2 * i + 1];
+    }
+}
+
+static void deinterleave(size_t count)
+{
+    float* planar[2] = { &output[0][0], &output[1][0] };
+    VectorMath::deinterleave(&inputs[0][0], 2, planar, count);
+}
+
+static std::vector<int16_t> pcm16;
+static std::vector<uint8_t> pcm24;
+
+static void preparePCM(size_t count)
+{
+    prepareFloats(count);
+    pcm16.resize(count + 1);
+    for (int16_t& sample : pcm16)
+        sample = static_cast<int16_t>(rand());
+    pcm24.resize(3 * count + 1);
+    for (uint8_t& byte : pcm24)
+        byte = static_cast<uint8_t>(rand());
+}
+
+// PCM conversions of WavDecoder, which had no scalar version before.
+static void int16ToFloatScalar(size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+        output[0][i] = pcm16[i] / 32768.0f;
+}
+
+static void int16ToFloat(size_t count)
+{
+    VectorMath::int16ToFloat(&pcm16[0], &output[0][0], count);
+}
+
+static void int24ToFloatScalar(size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* bytes = &pcm24[3 * i];
+        int32_t sample = static_cast<int32_t>(static_cast<uint32_t>(bytes[0]) << 8 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 24) >> 8;
+        output[0][i] = sample / 8388608.0f;
+    }
+}
+
+// Its widest x86 path is SSSE3.
+static void int24ToFloat(size_t count)
+{
+    VectorMath::int24ToFloat(&pcm24[0], &output[0][0], count);
+}
+
+// What Resampler computes for each output sample.
+static void dotProductScalar(size_t count)
+{
+    float sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += inputs[0][i] * inputs[1][i];
+    output[0][0] = sum;
+}
+
+static void dotProduct(size_t count)
+{
+    output[0][0] = VectorMath::dotProduct(&inputs[0][0], &inputs[1][0], count);
+}
+
+static const Kernel kernels[] = {
+    { "complexMultiply", prepareFloats, complexMultiplyScalar, complexMultiply, 0 },
+    { "interleave 2", prepareFloats, interleaveScalar, interleave, 0 },
+    { "deinterleave 2", prepareFloats, deinterleaveScalar, deinterleave, 0 },
+    { "int16ToFloat", preparePCM, int16ToFloatScalar, int16ToFloat, 0 },
+    { "int24ToFloat", preparePCM, int24ToFloatScalar, int24ToFloat, 0 },
+    { "dotProduct", prepareFloats, dotProductScalar, dotProduct, 1e-5f },
+};
+
+static void check(const Kernel& kernel)
+{
+    for (size_t count = 0; count <= 67; ++count) {
+        kernel.prepare(count);
+        kernel.scalar(count);
+        std::vector<float> expected[2] = { output[0], output[1] };
+        for (std::vector<float>& data : output)
+            std::fill(data.begin(), data.end(), 0);
+        kernel.vectorized(count);
+        float difference = 0;
+        for (unsigned i = 0; i < 2; ++i) {
+            for (size_t j = 0; j < output[i].size(); ++j)
+                difference = std::max(difference, std::fabs(output[i][j] - expected[i][j]));
+        }
+        if (!AudioTest::check(difference <= kernel.tolerance, kernel.name)) {
+            fprintf(stderr, "  differs from the scalar loop on %zu elements\n", count);
+            return;
+        }
+    }
+}
+
+// Nanoseconds per element.
+static double time(void (*run)(size_t), size_t count)
+{
+    unsigned iterations = std::max<size_t>(16, (1 << 24) / count);
+    run(count);
+    double start = AudioTest::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        run(count);
+    return (AudioTest::now() - start) * 1e9 / iterations / count;
+}
+
+int main()
+{
+    for (bool baselineOnly : { false, true }) {
+        VectorMath::useBaselineInstructionsOnly(baselineOnly);
+        for (const Kernel& kernel : kernels)
+            check(kernel);
+    }
+
+    printf("ns per element    scalar  %6s  %6s\n", baselineInstructions, widestInstructions);
+    for (const Kernel& kernel : kernels) {
+        printf("%s\n", kernel.name);
+        // The bins of FFT sizes 128 to 32768.
+        for (size_t count = 64; count <= 16384; count *= 4) {
+            kernel.prepare(count);
+            double scalar = time(kernel.scalar, count);
+            VectorMath::useBaselineInstructionsOnly(true);
+            double baseline = time(kernel.vectorized, count);
+            VectorMath::useBaselineInstructionsOnly(false);
+            double widest = time(kernel.vectorized, count);
+            printf("  %5zu           %6.3f  %6.3f  %6.3f\n", count, scalar, baseline, widest);
+        }
+    }
+    return AudioTest::result();
+}
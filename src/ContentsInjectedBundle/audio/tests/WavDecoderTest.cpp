@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Decodes generated WAV files of every format WavDecoder handles, in-tree and
+// through the GStreamer pipeline it replaces for them, checks both give the
+// samples that were encoded, and times both on a second of audio.
+
+#include "AudioFileReader.h"
+#include "AudioTest.h"
+#include "WavDecoder.h"
+
+#include <NixPlatform/AudioBus.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <gst/gst.h>
+#include <stdint.h>
+#include <vector>
+
+static const unsigned sampleRate = 44100;
+
+enum Format {
+    PCM16,
+    PCM24,
+    Float32
+};
+
+static const char* formatName(Format format)
+{
+    switch (format) {
+    case PCM16:
+        return "PCM16";
+    case PCM24:
+        return "PCM24";
+    case Float32:
+        return "float32";
+    }
+    return "";
+}
+
+// A WAV file and the planar samples it holds.
+struct WavFile {
+    std::vector<uint8_t> bytes;
+    std::vector<float> channels[2];
+};
+
+static void append16(std::vector<uint8_t>& bytes, uint16_t value)
+{
+    bytes.push_back(value & 0xff);
+    bytes.push_back(value >> 8);
+}
+
+static void append32(std::vector<uint8_t>& bytes, uint32_t value)
+{
+    append16(bytes, value & 0xffff);
+    append16(bytes, value >> 16);
+}
+
+static void appendTag(std::vector<uint8_t>& bytes, const char* tag)
+{
+    bytes.insert(bytes.end(), tag, tag + 4);
+}
+
+// A 440 Hz tone on the left, 660 Hz on the right. An odd sized LIST chunk
+// before fmt checks the padding is skipped.
+static WavFile makeWav(Format format, unsigned channels, size_t frames, bool extraChunk)
+{
+    unsigned bytesPerSample = format == PCM16 ? 2 : format == PCM24 ? 3 : 4;
+    WavFile file;
+    std::vector<uint8_t>& bytes = file.bytes;
+    appendTag(bytes, "RIFF");
+    append32(bytes, 0); // Patched below.
+    appendTag(bytes, "WAVE");
+    if (extraChunk) {
+        appendTag(bytes, "LIST");
+        append32(bytes, 5);
+        appendTag(bytes, "INFO");
+        bytes.push_back(0);
+        bytes.push_back(0); // Padding.
+    }
+    appendTag(bytes, "fmt ");
+    append32(bytes, 16);
+    append16(bytes, format == Float32 ? 3 : 1);
+    append16(bytes, channels);
+    append32(bytes, sampleRate);
+    append32(bytes, sampleRate * channels * bytesPerSample);
+    append16(bytes, channels * bytesPerSample);
+    append16(bytes, bytesPerSample * 8);
+    appendTag(bytes, "data");
+    append32(bytes, frames * channels * bytesPerSample);
+
+    for (unsigned channel = 0; channel < 2; ++channel)
+        file.channels[channel].resize(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        for (unsigned channel = 0; channel < channels; ++channel) {
+            double value = 0.8 * sin(2 * M_PI * (440 + 220 * channel) * i / sampleRate);
+            float decoded = 0;
+            switch (format) {
+            case PCM16: {
+                int16_t sample = static_cast<int16_t>(lrint(value * 32767));
+                append16(bytes, static_cast<uint16_t>(sample));
+                decoded = sample / 32768.0f;
+                break;
+            }
+            case PCM24: {
+                int32_t sample = static_cast<int32_t>(lrint(value * 8388607));
+                bytes.push_back(sample & 0xff);
+                bytes.push_back((sample >> 8) & 0xff);
+                bytes.push_back((sample >> 16) & 0xff);
+                decoded = sample / 8388608.0f;
+                break;
+            }
+            case Float32: {
+                decoded = static_cast<float>(value);
+                uint32_t bits;
+                memcpy(&bits, &decoded, sizeof(bits));
+                append32(bytes, bits);
+                break;
+            }
+            }
+            file.channels[channel][i] = decoded;
+        }
+    }
+    // Mono files are decoded to both channels.
+    if (channels == 1)
+        file.channels[1] = file.channels[0];
+
+    uint32_t riffSize = bytes.size() - 8;
+    for (unsigned i = 0; i < 4; ++i)
+        bytes[4 + i] = (riffSize >> (8 * i)) & 0xff;
+    return file;
+}
+
+static double largestDifference(Nix::AudioBus& bus, const WavFile& file)
+{
+    double difference = 0;
+    for (unsigned channel = 0; channel < 2; ++channel) {
+        const float* data = bus.channelData(channel);
+        for (size_t i = 0; i < file.channels[channel].size(); ++i)
+            difference = std::max(difference, std::fabs(static_cast<double>(data[i]) - file.channels[channel][i]));
+    }
+    return difference;
+}
+
+static void checkDecoding(Format format, unsigned channels, bool extraChunk)
+{
+    const size_t frames = 4097;
+    WavFile file = makeWav(format, channels, frames, extraChunk);
+    printf("%s, %u channel(s)%s\n", formatName(format), channels, extraChunk ? ", LIST chunk first" : "");
+
+    WavDecoder decoder(&file.bytes[0], file.bytes.size());
+    AudioTest::check(decoder.canDecode(sampleRate), "WavDecoder takes the file");
+    Nix::AudioBus inTree;
+    AudioTest::check(decoder.createBus(&inTree, sampleRate), "WavDecoder decodes the file");
+    AudioTest::check(inTree.length() == frames, "WavDecoder decodes every frame");
+    if (inTree.length() == frames)
+        AudioTest::check(!largestDifference(inTree, file), "WavDecoder gives the encoded samples");
+
+    // DROWSER_AUDIO_WAV_DECODER=0 is set, AudioFileReader uses the pipeline.
+    AudioFileReader reader(&file.bytes[0], file.bytes.size());
+    Nix::AudioBus gstreamer;
+    AudioTest::check(reader.createBus(&gstreamer, sampleRate), "GStreamer decodes the file");
+    AudioTest::check(gstreamer.length() == frames, "GStreamer decodes every frame");
+    if (gstreamer.length() == frames)
+        AudioTest::check(largestDifference(gstreamer, file) < 1e-6, "GStreamer gives the encoded samples");
+}
+
+// Microseconds to decode the file into a bus, allocation included.
+static double timeWavDecoder(const WavFile& file)
+{
+    const unsigned iterations = 200;
+    double start = AudioTest::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        Nix::AudioBus bus;
+        WavDecoder(&file.bytes[0], file.bytes.size()).createBus(&bus, sampleRate);
+    }
+    return (AudioTest::now() - start) * 1e6 / iterations;
+}
+
+static double timeGStreamer(const WavFile& file)
+{
+    const unsigned iterations = 20;
+    double start = AudioTest::now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        Nix::AudioBus bus;
+        AudioFileReader(&file.bytes[0], file.bytes.size()).createBus(&bus, sampleRate);
+    }
+    return (AudioTest::now() - start) * 1e6 / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    // Read by AudioConfig the first time it's needed: send plain WAV files
+    // through the pipeline, and don't let the decode cache answer for it.
+    setenv("DROWSER_AUDIO_WAV_DECODER", "0", 1);
+    setenv("DROWSER_AUDIO_CACHE_SIZE", "0", 1);
+    gst_init(&argc, &argv);
+
+    for (Format format : { PCM16, PCM24, Float32 }) {
+        for (unsigned channels = 1; channels <= 2; ++channels) {
+            checkDecoding(format, channels, false);
+            checkDecoding(format, channels, true);
+        }
+    }
+
+    printf("\none second of stereo  WavDecoder   GStreamer\n");
+    for (Format format : { PCM16, PCM24, Float32 }) {
+        WavFile file = makeWav(format, 2, sampleRate, false);
+        // The first pipeline run loads the plugins.
+        timeGStreamer(file);
+        double inTree = timeWavDecoder(file);
+        double gstreamer = timeGStreamer(file);
+        printf("%-20s  %8.0fus  %8.0fus  %.0fx\n", formatName(format), inTree, gstreamer, gstreamer / inTree);
+    }
+    return AudioTest::result();
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Plays the Web Audio source into a fakesink with the quantum sizes
+// AudioHardware picks for usual devices, and checks WebCore is asked for
+// that many frames and the sink gets them, with and without a prebuffer.
+
+#include "AudioTest.h"
+#include "WebKitWebAudioSourceGStreamer.h"
+
+#include <NixPlatform/Platform.h>
+#include <gst/gst.h>
+
+static const unsigned channels = 2;
+static const unsigned buffersToCheck = 64;
+
+// Marks every sample with the number of its quantum.
+class CountingCallback : public Nix::AudioDevice::RenderCallback {
+public:
+    CountingCallback() : quanta(0), wrongSizes(0), framesAsked(0) { }
+
+    virtual void render(Nix::Vector<float*>&, Nix::Vector<float*>& destination, size_t frames)
+    {
+        if (frames != framesAsked)
+            wrongSizes++;
+        quanta++;
+        for (size_t channel = 0; channel < destination.size(); ++channel) {
+            for (size_t i = 0; i < frames; ++i)
+                destination[channel][i] = quanta;
+        }
+    }
+
+    unsigned quanta;
+    unsigned wrongSizes;
+    size_t framesAsked;
+};
+
+struct SinkCounts {
+    gint buffers; // Read from the main thread while the streaming thread counts.
+    unsigned wrongSizes;
+    size_t bytesExpected;
+};
+
+static void handoffCallback(GstElement*, GstBuffer* buffer, GstPad*, SinkCounts* counts)
+{
+#ifdef GST_API_VERSION_1
+    size_t size = gst_buffer_get_size(buffer);
+#else
+    size_t size = GST_BUFFER_SIZE(buffer);
+#endif
+    if (size != counts->bytesExpected)
+        counts->wrongSizes++;
+    g_atomic_int_inc(&counts->buffers);
+}
+
+static void play(unsigned frames, unsigned prebuffer)
+{
+    printf("%u frames, prebuffer %u\n", frames, prebuffer);
+
+    CountingCallback callback;
+    callback.framesAsked = frames;
+    GstElement* source = reinterpret_cast<GstElement*>(g_object_new(WEBKIT_TYPE_WEB_AUDIO_SRC,
+                                                                     "rate", 48000.0,
+                                                                     "handler", &callback,
+                                                                     "frames", frames,
+                                                                     "channels", channels,
+                                                                     "prebuffer", prebuffer, NULL));
+    guint framesSet = 0;
+    g_object_get(source, "frames", &framesSet, NULL);
+    AudioTest::check(framesSet == frames, "the source takes the frames it's created with");
+
+    SinkCounts counts = { 0, 0, frames * channels * sizeof(float) };
+    GstElement* sink = gst_element_factory_make("fakesink", 0);
+    g_object_set(sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(sink, "handoff", G_CALLBACK(handoffCallback), &counts);
+
+    GstElement* pipeline = gst_pipeline_new(0);
+    gst_bin_add_many(GST_BIN(pipeline), source, sink, NULL);
+    gst_element_link(source, sink);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    for (unsigned i = 0; i < 500 && g_atomic_int_get(&counts.buffers) < static_cast<gint>(buffersToCheck); ++i)
+        g_usleep(10000);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    AudioTest::check(counts.buffers >= static_cast<gint>(buffersToCheck), "the sink gets buffers");
+    AudioTest::check(!counts.wrongSizes, "buffers hold a whole quantum");
+    AudioTest::check(callback.quanta >= buffersToCheck, "WebCore renders");
+    AudioTest::check(!callback.wrongSizes, "WebCore is asked for the quantum size");
+}
+
+int main(int argc, char** argv)
+{
+    gst_init(&argc, &argv);
+
+    const unsigned sizes[] = { 128, 256, 512, 1024 };
+    for (unsigned frames : sizes) {
+        play(frames, 0);
+        play(frames, 2 * frames);
+    }
+    return AudioTest::result();
+}
@@ -0,0 +1,77 @@
+#!/bin/sh
+# Measures what DROWSER_AUDIO_MIXER=1 saves: opens a number of tabs, each
+# playing a quiet tone from its own AudioContext, and reports the CPU time and
+# the context switches (wakeups) per second of the browser, its web processes
+# and the sound server, with and without the mixer. Needs a display and an
+# audio device, so it isn't run by ctest.
+#
+# Usage: measure-mixer.sh path/to/drowser [tabs] [seconds]
+
+drowser=$1
+tabs=${2:-4}
+seconds=${3:-20}
+page="file://$(cd "$(dirname "$0")" && pwd)/mixer-load.html"
+
+if [ ! -x "$drowser" ]; then
+    echo "usage: $0 path/to/drowser [tabs] [seconds]" >&2
+    exit 1
+fi
+
+ticksPerSecond=$(getconf CLK_TCK)
+
+# The process and all its descendants.
+processTree() {
+    echo "$1"
+    for child in $(ps -o pid= --ppid "$1"); do
+        processTree "$child"
+    done
+}
+
+soundServers() {
+    pgrep -x pulseaudio
+    pgrep -x pipewire
+    pgrep -x pipewire-pulse
+}
+
+# CPU ticks, then context switches of every thread, summed over the pids given.
+sample() {
+    ticks=0
+    switches=0
+    for pid in "$@"; do
+        [ -r "/proc/$pid/stat" ] || continue
+        # The command name may hold spaces, count fields from the closing parenthesis.
+        ticks=$((ticks + $(sed 's/.*) //' "/proc/$pid/stat" | awk '{ print $12 + $13 }')))
+        switches=$((switches + $(cat /proc/"$pid"/task/*/status 2>/dev/null | awk '/ctxt_switches/ { sum += $2 } END { print sum + 0 }')))
+    done
+    echo "$ticks $switches"
+}
+
+run() {
+    urls=
+    i=0
+    while [ $i -lt "$tabs" ]; do
+        urls="$urls $page"
+        i=$((i + 1))
+    done
+
+    DROWSER_AUDIO_MIXER=$1 "$drowser" $urls >/dev/null 2>&1 &
+    browser=$!
+    # Let the pages load and the pipelines settle.
+    sleep 5
+
+    pids="$(processTree $browser) $(soundServers)"
+    set -- $(sample $pids)
+    sleep "$seconds"
+    set -- "$@" $(sample $pids)
+    kill $browser
+    wait $browser 2>/dev/null
+
+    echo "$1 $2 $3 $4" | awk -v tps="$ticksPerSecond" -v seconds="$seconds" -v label="$label" \
+        '{ printf "%-14s %6.1f%% CPU  %8.0f wakeups/s\n", label, ($3 - $1) * 100 / tps / seconds, ($4 - $2) / seconds }'
+}
+
+echo "$tabs tabs playing, measured over $seconds s, browser, web processes and sound server together"
+label="own sinks"
+run 0
+label="mixer"
+run 1
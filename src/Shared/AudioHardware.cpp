@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioHardware.h"
+
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <cstdio>
+
+GST_DEBUG_CATEGORY_STATIC(webkit_audio_hardware_debug);
+#define GST_CAT_DEFAULT webkit_audio_hardware_debug
+
+static const int fallbackSampleRate = 44100;
+static const unsigned fallbackChannels = 2;
+// AudioDestination renders up to 7.1.
+static const unsigned maximumChannels = 8;
+// Audio sinks default to a latency-time of 10ms, which is the period the
+// device gets when it doesn't ask for anything else.
+static const unsigned defaultPeriodMilliseconds = 10;
+const size_t AudioHardware::minimumBufferSize;
+const size_t AudioHardware::maximumBufferSize;
+
+// The value of field if it's fixed, or the preferred one if it's in a list.
+// Ranges and missing fields don't say anything.
+static int readCapsInt(const GstStructure* structure, const char* field, int preferred)
+{
+    const GValue* value = gst_structure_get_value(structure, field);
+    if (!value)
+        return 0;
+    if (G_VALUE_HOLDS_INT(value))
+        return g_value_get_int(value);
+    if (GST_VALUE_HOLDS_LIST(value)) {
+        for (guint i = 0; i < gst_value_list_get_size(value); ++i) {
+            const GValue* item = gst_value_list_get_value(value, i);
+            if (G_VALUE_HOLDS_INT(item) && g_value_get_int(item) == preferred)
+                return preferred;
+        }
+    }
+    return 0;
+}
+
+static void readCaps(GstCaps* caps, int& sampleRate, int& channels)
+{
+    if (!caps || gst_caps_is_empty(caps) || gst_caps_is_any(caps))
+        return;
+    const GstStructure* structure = gst_caps_get_structure(caps, 0);
+    sampleRate = readCapsInt(structure, "rate", 48000);
+    if (!sampleRate)
+        sampleRate = readCapsInt(structure, "rate", fallbackSampleRate);
+    channels = readCapsInt(structure, "channels", fallbackChannels);
+}
+
+#if GST_CHECK_VERSION(1, 4, 0)
+// PipeWire says how many frames a period holds as "node.latency", frames/rate.
+static unsigned readDevicePeriod(GstDevice* device, int sampleRate)
+{
+    GstStructure* properties = gst_device_get_properties(device);
+    if (!properties)
+        return 0;
+
+    unsigned frames = 0;
+    const char* latency = gst_structure_get_string(properties, "node.latency");
+    unsigned latencyFrames, latencyRate;
+    if (latency && sscanf(latency, "%u/%u", &latencyFrames, &latencyRate) == 2 && latencyRate)
+        frames = static_cast<unsigned long long>(latencyFrames) * sampleRate / latencyRate;
+    gst_structure_free(properties);
+    return frames;
+}
+
+static bool isDefaultDevice(GstDevice* device)
+{
+    GstStructure* properties = gst_device_get_properties(device);
+    gboolean isDefault = FALSE;
+    if (properties) {
+        gst_structure_get_boolean(properties, "is-default", &isDefault);
+        gst_structure_free(properties);
+    }
+    return isDefault;
+}
+
+static bool probeDeviceMonitor(int& sampleRate, int& channels, unsigned& periodFrames)
+{
+    GstDeviceMonitor* monitor = gst_device_monitor_new();
+    gst_device_monitor_add_filter(monitor, "Audio/Sink", 0);
+    GList* devices = gst_device_monitor_get_devices(monitor);
+
+    // Providers that know which one is the default say so, the others list it first.
+    GstDevice* device = devices ? GST_DEVICE(devices->data) : 0;
+    for (GList* item = devices; item; item = item->next) {
+        if (isDefaultDevice(GST_DEVICE(item->data))) {
+            device = GST_DEVICE(item->data);
+            break;
+        }
+    }
+
+    if (device) {
+        gchar* name = gst_device_get_display_name(device);
+        GST_INFO("Default output device: %s", name);
+        g_free(name);
+
+        GstCaps* caps = gst_device_get_caps(device);
+        readCaps(caps, sampleRate, channels);
+        if (caps)
+            gst_caps_unref(caps);
+        if (sampleRate)
+            periodFrames = readDevicePeriod(device, sampleRate);
+    }
+
+    g_list_free_full(devices, gst_object_unref);
+    gst_object_unref(monitor);
+    return device;
+}
+#endif
+
+// Without a device monitor, what the sink accepts once it opened the device.
+static bool probeSinkCaps(int& sampleRate, int& channels)
+{
+    GstElement* sink = gst_element_factory_make("autoaudiosink", 0);
+    if (!sink)
+        return false;
+
+    bool opened = gst_element_set_state(sink, GST_STATE_READY) != GST_STATE_CHANGE_FAILURE;
+    if (opened) {
+        GstPad* pad = gst_element_get_static_pad(sink, "sink");
+#ifdef GST_API_VERSION_1
+        GstCaps* caps = gst_pad_query_caps(pad, 0);
+#else
+        GstCaps* caps = gst_pad_get_caps(pad);
+#endif
+        readCaps(caps, sampleRate, channels);
+        if (caps)
+            gst_caps_unref(caps);
+        gst_object_unref(pad);
+    }
+
+    gst_element_set_state(sink, GST_STATE_NULL);
+    gst_object_unref(sink);
+    return opened;
+}
+
+const AudioHardware& AudioHardware::get()
+{
+    static AudioHardware hardware(true);
+    return hardware;
+}
+
+const AudioHardware& AudioHardware::unprobed()
+{
+    static AudioHardware hardware(false);
+    return hardware;
+}
+
+AudioHardware::AudioHardware(bool probe)
+{
+    if (!webkit_audio_hardware_debug)
+        GST_DEBUG_CATEGORY_INIT(webkit_audio_hardware_debug, "webkitaudiohardware", 0, "WebAudio hardware");
+
+    int probedRate = 0;
+    int probedChannels = 0;
+    unsigned periodFrames = 0;
+
+    if (probe) {
+        bool found = false;
+#if GST_CHECK_VERSION(1, 4, 0)
+        found = probeDeviceMonitor(probedRate, probedChannels, periodFrames);
+#endif
+        if (!found)
+            probeSinkCaps(probedRate, probedChannels);
+    }
+
+    sampleRate = probedRate > 0 ? probedRate : fallbackSampleRate;
+    outputChannels = probedChannels > 0 ? std::min<unsigned>(probedChannels, maximumChannels) : fallbackChannels;
+
+    // The largest power of two that fits in a period: one push per period
+    // at most, without adding latency over what the device has anyway.
+    if (!periodFrames)
+        periodFrames = sampleRate * defaultPeriodMilliseconds / 1000;
+    bufferSize = minimumBufferSize;
+    while (bufferSize * 2 <= periodFrames && bufferSize * 2 <= maximumBufferSize)
+        bufferSize *= 2;
+
+    GST_INFO("Output at %.0fHz, %u channels, %zu frames per buffer%s", sampleRate, outputChannels, bufferSize,
+             probedRate > 0 ? "" : " (rate not probed)");
+}
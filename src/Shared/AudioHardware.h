@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioHardware_h
+#define AudioHardware_h
+
+#include <cstddef>
+
+// What the default output device works with, for the audioHardware* queries
+// of the Platform and the rate of the Browser audio mixer, which have to
+// agree. Probed once, on first use: the device's caps give the rate and
+// channels when they're fixed, as with PipeWire, and the period is the one it
+// announces or the sink's default latency. Anything the probe can't tell, or
+// no device at all, falls back to 44100Hz stereo.
+struct AudioHardware {
+    static const AudioHardware& get();
+    // The fallback alone, for rendering that never goes near the device.
+    static const AudioHardware& unprobed();
+
+    // WebCore renders quanta of 128 frames and its FIFO takes 8192.
+    static const size_t minimumBufferSize = 128;
+    static const size_t maximumBufferSize = 4096;
+
+    float sampleRate;
+    size_t bufferSize;
+    unsigned outputChannels;
+
+private:
+    explicit AudioHardware(bool probe);
+};
+
+#endif
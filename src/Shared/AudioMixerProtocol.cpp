@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioMixerProtocol.h"
+
+#include <cstring>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace AudioMixerProtocol {
+
+bool sendMessage(int socket, const Message& message, const int* descriptors, unsigned descriptorCount)
+{
+    iovec iov;
+    iov.iov_base = const_cast<Message*>(&message);
+    iov.iov_len = sizeof(message);
+
+    char control[CMSG_SPACE(sizeof(int) * maximumDescriptors)];
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+
+    if (descriptorCount) {
+        header.msg_control = control;
+        header.msg_controllen = CMSG_SPACE(sizeof(int) * descriptorCount);
+        cmsghdr* controlMessage = CMSG_FIRSTHDR(&header);
+        controlMessage->cmsg_level = SOL_SOCKET;
+        controlMessage->cmsg_type = SCM_RIGHTS;
+        controlMessage->cmsg_len = CMSG_LEN(sizeof(int) * descriptorCount);
+        memcpy(CMSG_DATA(controlMessage), descriptors, sizeof(int) * descriptorCount);
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == sizeof(message);
+}
+
+bool receiveMessage(int socket, Message& message, int* descriptors, unsigned& descriptorCount)
+{
+    iovec iov;
+    iov.iov_base = &message;
+    iov.iov_len = sizeof(message);
+
+    char control[CMSG_SPACE(sizeof(int) * maximumDescriptors)];
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &iov;
+    header.msg_iovlen = 1;
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+
+    ssize_t received;
+    do {
+        received = recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+
+    descriptorCount = 0;
+    for (cmsghdr* controlMessage = CMSG_FIRSTHDR(&header); controlMessage; controlMessage = CMSG_NXTHDR(&header, controlMessage)) {
+        if (controlMessage->cmsg_level != SOL_SOCKET || controlMessage->cmsg_type != SCM_RIGHTS)
+            continue;
+        unsigned count = (controlMessage->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int* passed = reinterpret_cast<int*>(CMSG_DATA(controlMessage));
+        for (unsigned i = 0; i < count; ++i) {
+            if (descriptorCount < maximumDescriptors)
+                descriptors[descriptorCount++] = passed[i];
+            else
+                close(passed[i]);
+        }
+    }
+
+    if (received != sizeof(message) || (header.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+        for (unsigned i = 0; i < descriptorCount; ++i)
+            close(descriptors[i]);
+        descriptorCount = 0;
+        return false;
+    }
+    return true;
+}
+
+}
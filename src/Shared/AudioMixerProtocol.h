@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioMixerProtocol_h
+#define AudioMixerProtocol_h
+
+#include <fcntl.h>
+#include <stdint.h>
+
+// Older C libraries don't know about file sealing yet, the kernel has it since 3.17.
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+// Web processes and the Browser audio mixer talk over a unix seqpacket socket
+// whose abstract name the Browser puts in the environment before any web
+// process is spawned. A web process connects once per audio device and sends
+// Hello along with the sealed memfd holding an AudioRingBuffer and an
+// eventfd. From then on audio only flows through the ring: the web process
+// renders into it and the mixer drains it, writing to the eventfd whenever it
+// made room. Start and Stop tell the mixer whether to expect data, closing the
+// socket ends the stream.
+namespace AudioMixerProtocol {
+
+static const char socketNameVariable[] = "DROWSER_AUDIO_MIXER_SOCKET";
+static const char sampleRateVariable[] = "DROWSER_AUDIO_MIXER_RATE";
+
+// The mixer only takes streams in its own format.
+static const unsigned channels = 2;
+// Frames mixed per buffer pushed to the sink.
+static const unsigned periodFrames = 256;
+
+enum MessageType {
+    Hello = 1,
+    Start,
+    Stop
+};
+
+struct Message {
+    uint32_t type;
+    uint32_t memorySize; // Hello only, size of the memfd mapping.
+};
+
+// The memfd can't be resized once sent, or the mixer would fault on its mapping.
+static const int requiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// Hello carries two descriptors, the others none.
+static const unsigned maximumDescriptors = 2;
+
+bool sendMessage(int socket, const Message&, const int* descriptors, unsigned descriptorCount);
+// Returns false when the connection is gone or the message is malformed.
+bool receiveMessage(int socket, Message&, int* descriptors, unsigned& descriptorCount);
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "AudioRingBuffer.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+static size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+static const uint32_t headerMagic = 0x52425546; // "RBUF"
+
+const unsigned AudioRingBuffer::maximumChannels;
+
+size_t AudioRingBuffer::memorySize(unsigned channels, size_t capacity)
+{
+    return sizeof(Header) + roundUpToPowerOfTwo(capacity) * std::min(channels, maximumChannels) * sizeof(float);
+}
+
+AudioRingBuffer::AudioRingBuffer(unsigned channels, size_t capacity, size_t maximumLatency)
+    : m_ownsMemory(true)
+    , m_channels(std::min(channels, maximumChannels))
+    , m_capacity(roundUpToPowerOfTwo(capacity))
+    , m_maximumLatency(std::min(maximumLatency, m_capacity))
+{
+    void* memory = 0;
+    if (posix_memalign(&memory, 64, memorySize(channels, capacity)))
+        throw std::bad_alloc();
+    initialize(memory);
+}
+
+AudioRingBuffer::AudioRingBuffer(void* memory, unsigned channels, size_t capacity, size_t maximumLatency)
+    : m_ownsMemory(false)
+    , m_channels(std::min(channels, maximumChannels))
+    , m_capacity(roundUpToPowerOfTwo(capacity))
+    , m_maximumLatency(std::min(maximumLatency, m_capacity))
+{
+    initialize(memory);
+}
+
+// The other side may be buggy or hostile, so the layout is read from the header
+// exactly once and only those copies are used afterwards. Anything that would
+// make us access out of bounds leaves the ring invalid.
+AudioRingBuffer::AudioRingBuffer(void* memory, size_t size)
+    : m_header(0)
+    , m_data(0)
+    , m_ownsMemory(false)
+    , m_channels(size >= sizeof(Header) ? static_cast<Header*>(memory)->channels : 0)
+    , m_capacity(size >= sizeof(Header) ? static_cast<Header*>(memory)->capacity : 0)
+    , m_maximumLatency(size >= sizeof(Header) ? std::min<size_t>(static_cast<Header*>(memory)->maximumLatency, m_capacity) : 0)
+{
+    Header* header = static_cast<Header*>(memory);
+    if (size < sizeof(Header) || header->magic != headerMagic)
+        return;
+    if (!m_channels || m_channels > maximumChannels || !m_capacity || (m_capacity & (m_capacity - 1)))
+        return;
+    if (memorySize(m_channels, m_capacity) > size)
+        return;
+
+    m_header = header;
+    m_data = reinterpret_cast<float*>(m_header + 1);
+}
+
+void AudioRingBuffer::initialize(void* memory)
+{
+    m_header = new (memory) Header();
+    m_header->writeIndex.store(0, std::memory_order_relaxed);
+    m_header->readIndex.store(0, std::memory_order_relaxed);
+    m_header->magic = headerMagic;
+    m_header->channels = m_channels;
+    m_header->capacity = m_capacity;
+    m_header->maximumLatency = m_maximumLatency;
+    m_header->overruns.store(0, std::memory_order_relaxed);
+    m_header->underruns.store(0, std::memory_order_relaxed);
+    m_header->reads.store(0, std::memory_order_relaxed);
+    m_header->latencyTotal.store(0, std::memory_order_relaxed);
+    m_header->latencyMax.store(0, std::memory_order_relaxed);
+
+    m_data = reinterpret_cast<float*>(m_header + 1);
+    memset(m_data, 0, m_capacity * m_channels * sizeof(float));
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+    if (!m_ownsMemory)
+        return;
+    m_header->~Header();
+    free(m_header);
+}
+
+size_t AudioRingBuffer::framesAvailable() const
+{
+    return m_header->writeIndex.load(std::memory_order_acquire) - m_header->readIndex.load(std::memory_order_acquire);
+}
+
+// Reserves room for up to frames frames, the caller copies them at writeIndex and publishes them.
+size_t AudioRingBuffer::beginWrite(size_t frames, uint64_t& writeIndex)
+{
+    writeIndex = m_header->writeIndex.load(std::memory_order_relaxed);
+    uint64_t readIndex = m_header->readIndex.load(std::memory_order_acquire);
+
+    // A consumer further ahead or behind than the ring is big is broken, write
+    // nothing until it resynchronizes.
+    size_t used = writeIndex - readIndex;
+    size_t space = used > m_capacity ? 0 : m_capacity - used;
+    size_t framesToWrite = std::min(frames, space);
+    if (framesToWrite < frames)
+        m_header->overruns.fetch_add(frames - framesToWrite, std::memory_order_relaxed);
+    return framesToWrite;
+}
+
+size_t AudioRingBuffer::write(const float* interleaved, size_t frames)
+{
+    unsigned channels = m_channels;
+    size_t capacity = m_capacity;
+    uint64_t writeIndex;
+    size_t framesToWrite = beginWrite(frames, writeIndex);
+
+    size_t offset = writeIndex & (capacity - 1);
+    size_t firstPart = std::min(framesToWrite, capacity - offset);
+    memcpy(m_data + offset * channels, interleaved, firstPart * channels * sizeof(float));
+    memcpy(m_data, interleaved + firstPart * channels, (framesToWrite - firstPart) * channels * sizeof(float));
+
+    m_header->writeIndex.store(writeIndex + framesToWrite, std::memory_order_release);
+    return framesToWrite;
+}
+
+size_t AudioRingBuffer::write(const float* const* planar, size_t frames)
+{
+    unsigned channels = m_channels;
+    size_t capacity = m_capacity;
+    uint64_t writeIndex;
+    size_t framesToWrite = beginWrite(frames, writeIndex);
+
+    size_t offset = writeIndex & (capacity - 1);
+    size_t firstPart = std::min(framesToWrite, capacity - offset);
+    const float* sources[maximumChannels];
+    VectorMath::interleave(planar, channels, m_data + offset * channels, firstPart);
+    for (unsigned i = 0; i < channels; ++i)
+        sources[i] = planar[i] + firstPart;
+    VectorMath::interleave(sources, channels, m_data, framesToWrite - firstPart);
+
+    m_header->writeIndex.store(writeIndex + framesToWrite, std::memory_order_release);
+    return framesToWrite;
+}
+
+// Finds how many frames can be read, the caller copies them from readIndex and calls endRead().
+size_t AudioRingBuffer::beginRead(size_t frames, uint64_t& readIndex, uint64_t& writeIndex)
+{
+    readIndex = m_header->readIndex.load(std::memory_order_relaxed);
+    writeIndex = m_header->writeIndex.load(std::memory_order_acquire);
+    size_t available = writeIndex - readIndex;
+
+    // Indexes further apart than the ring is big can only come from a broken
+    // producer, skip to where it says it is rather than trusting them.
+    if (available > m_capacity) {
+        readIndex = writeIndex;
+        available = 0;
+    }
+
+    m_header->reads.fetch_add(1, std::memory_order_relaxed);
+    m_header->latencyTotal.fetch_add(available, std::memory_order_relaxed);
+    if (available > m_header->latencyMax.load(std::memory_order_relaxed))
+        m_header->latencyMax.store(available, std::memory_order_relaxed);
+
+    if (available > m_maximumLatency) {
+        size_t excess = available - m_maximumLatency / 2;
+        m_header->overruns.fetch_add(excess, std::memory_order_relaxed);
+        readIndex += excess;
+        available -= excess;
+    }
+
+    return std::min(frames, available);
+}
+
+void AudioRingBuffer::endRead(uint64_t readIndex, uint64_t writeIndex, size_t framesRead, size_t framesRequested)
+{
+    // Nothing was ever written means the producer didn't start yet, that's not an underrun.
+    if (framesRead < framesRequested && writeIndex)
+        m_header->underruns.fetch_add(framesRequested - framesRead, std::memory_order_relaxed);
+
+    m_header->readIndex.store(readIndex + framesRead, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::read(float* const* planar, size_t frames)
+{
+    unsigned channels = m_channels;
+    size_t capacity = m_capacity;
+    uint64_t readIndex;
+    uint64_t writeIndex;
+    size_t framesToRead = beginRead(frames, readIndex, writeIndex);
+
+    size_t offset = readIndex & (capacity - 1);
+    size_t firstPart = std::min(framesToRead, capacity - offset);
+    float* destinations[maximumChannels];
+    VectorMath::deinterleave(m_data + offset * channels, channels, planar, firstPart);
+    for (unsigned i = 0; i < channels; ++i)
+        destinations[i] = planar[i] + firstPart;
+    VectorMath::deinterleave(m_data, channels, destinations, framesToRead - firstPart);
+
+    for (unsigned i = 0; i < channels; ++i)
+        memset(planar[i] + framesToRead, 0, (frames - framesToRead) * sizeof(float));
+
+    endRead(readIndex, writeIndex, framesToRead, frames);
+    return framesToRead;
+}
+
+size_t AudioRingBuffer::read(float* interleaved, size_t frames)
+{
+    unsigned channels = m_channels;
+    size_t capacity = m_capacity;
+    uint64_t readIndex;
+    uint64_t writeIndex;
+    size_t framesToRead = beginRead(frames, readIndex, writeIndex);
+
+    size_t offset = readIndex & (capacity - 1);
+    size_t firstPart = std::min(framesToRead, capacity - offset);
+    memcpy(interleaved, m_data + offset * channels, firstPart * channels * sizeof(float));
+    memcpy(interleaved + firstPart * channels, m_data, (framesToRead - firstPart) * channels * sizeof(float));
+    memset(interleaved + framesToRead * channels, 0, (frames - framesToRead) * channels * sizeof(float));
+
+    endRead(readIndex, writeIndex, framesToRead, frames);
+    return framesToRead;
+}
+
+void AudioRingBuffer::reset()
+{
+    m_header->readIndex.store(0, std::memory_order_relaxed);
+    m_header->writeIndex.store(0, std::memory_order_relaxed);
+}
+
+AudioRingBuffer::Stats AudioRingBuffer::stats() const
+{
+    Stats stats;
+    stats.overruns = m_header->overruns.load(std::memory_order_relaxed);
+    stats.underruns = m_header->underruns.load(std::memory_order_relaxed);
+    uint64_t reads = m_header->reads.load(std::memory_order_relaxed);
+    stats.latencyAverage = reads ? m_header->latencyTotal.load(std::memory_order_relaxed) / reads : 0;
+    stats.latencyMax = m_header->latencyMax.load(std::memory_order_relaxed);
+    return stats;
+}
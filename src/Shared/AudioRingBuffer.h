@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AudioRingBuffer_h
+#define AudioRingBuffer_h
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+// Lock-free single producer, single consumer ring of interleaved float frames.
+// Either side can work with interleaved or planar data, the conversion happens
+// while copying in or out of the ring. Neither side ever blocks: the producer
+// drops what doesn't fit and the consumer fills what's missing with silence,
+// both counted in the ring stats. Callers that need to wait for data or room
+// do so on their own. The ring lives in a single block of memory with no
+// pointers in it, so it can be shared between processes.
+class AudioRingBuffer
+{
+public:
+    static const unsigned maximumChannels = 8;
+
+    struct Stats {
+        uint64_t overruns; // Frames dropped because the consumer was behind.
+        uint64_t underruns; // Frames replaced by silence because the producer was behind.
+        uint64_t latencyAverage; // Frames buffered when the consumer reads.
+        uint64_t latencyMax;
+    };
+
+    // The capacity is rounded up to a power of two. When more than maximumLatency
+    // frames are buffered the consumer drops the oldest ones to get back to half
+    // of it, so a producer running slightly faster doesn't add latency forever.
+    AudioRingBuffer(unsigned channels, size_t capacity, size_t maximumLatency);
+    // Builds the ring in memory provided by the caller, at least memorySize() bytes.
+    AudioRingBuffer(void* memory, unsigned channels, size_t capacity, size_t maximumLatency);
+    // Uses a ring somebody else built in that memory, check isValid() before using it.
+    AudioRingBuffer(void* memory, size_t memorySize);
+    ~AudioRingBuffer();
+
+    static size_t memorySize(unsigned channels, size_t capacity);
+    bool isValid() const { return m_header; }
+
+    unsigned channels() const { return m_channels; }
+    size_t capacity() const { return m_capacity; }
+    size_t framesAvailable() const;
+
+    // Producer side, returns the number of frames written.
+    size_t write(const float* interleaved, size_t frames);
+    size_t write(const float* const* planar, size_t frames);
+
+    // Consumer side, always fills frames samples of every channel and returns how
+    // many of them came from the ring.
+    size_t read(float* const* planar, size_t frames);
+    size_t read(float* interleaved, size_t frames);
+
+    // Empties the ring, only when neither side is running.
+    void reset();
+
+    Stats stats() const;
+
+private:
+    size_t beginWrite(size_t frames, uint64_t& writeIndex);
+    size_t beginRead(size_t frames, uint64_t& readIndex, uint64_t& writeIndex);
+    void endRead(uint64_t readIndex, uint64_t writeIndex, size_t framesRead, size_t framesRequested);
+    void initialize(void* memory);
+
+    // Indexes count frames since the ring was created and only grow, they're
+    // wrapped when accessing m_data. Each one is written by a single side and
+    // lives in its own cache line.
+    struct Header {
+        std::atomic<uint64_t> writeIndex;
+        char writePadding[64 - sizeof(uint64_t)];
+        std::atomic<uint64_t> readIndex;
+        char readPadding[64 - sizeof(uint64_t)];
+
+        uint32_t magic;
+        uint32_t channels;
+        uint32_t capacity;
+        uint32_t maximumLatency;
+
+        std::atomic<uint64_t> overruns;
+        std::atomic<uint64_t> underruns;
+        std::atomic<uint64_t> reads;
+        std::atomic<uint64_t> latencyTotal;
+        std::atomic<uint64_t> latencyMax;
+    };
+
+    Header* m_header;
+    float* m_data;
+    bool m_ownsMemory;
+
+    // Copied out of the header once, the other side can still write to it.
+    const unsigned m_channels;
+    const size_t m_capacity;
+    const size_t m_maximumLatency;
+};
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "IPCTracer.h"
+#include "StringPool.h"
+#include <WebKit2/WKArray.h>
+#include <WebKit2/WKNumber.h>
+#include <WebKit2/WKString.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+static const unsigned defaultSummaryInterval = 10;
+
+IPCTracer& IPCTracer::instance()
+{
+    static IPCTracer tracer;
+    return tracer;
+}
+
+IPCTracer::IPCTracer()
+    : m_enabled(false)
+    , m_summaryInterval(0)
+    , m_recordCount(0)
+    , m_roundTrips(0)
+    , m_roundTripTime(0)
+    , m_roundTripMin(0)
+    , m_roundTripMax(0)
+    , m_lastSummaryTime(now())
+{
+    const char* trace = getenv("DROWSER_IPC_TRACE");
+    m_enabled = trace && *trace && strcmp(trace, "0");
+    if (!m_enabled)
+        return;
+
+    m_summaryInterval = defaultSummaryInterval;
+    if (const char* interval = getenv("DROWSER_IPC_TRACE_INTERVAL"))
+        m_summaryInterval = atoi(interval);
+
+    char name[32];
+    snprintf(name, sizeof(name), "pid %d", getpid());
+    m_processName = name;
+}
+
+uint64_t IPCTracer::now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+size_t IPCTracer::payloadSize(WKTypeRef value)
+{
+    if (!value)
+        return 0;
+
+    WKTypeID type = WKGetTypeID(value);
+    if (type == WKStringGetTypeID())
+        return WKStringGetLength((WKStringRef)value) * sizeof(uint16_t);
+    if (type == WKArrayGetTypeID()) {
+        WKArrayRef array = (WKArrayRef)value;
+        size_t size = sizeof(uint64_t);
+        for (size_t i = 0; i < WKArrayGetSize(array); ++i)
+            size += payloadSize(WKArrayGetItemAtIndex(array, i));
+        return size;
+    }
+    return sizeof(uint64_t);
+}
+
+void IPCTracer::record(Direction direction, StringView name, size_t payloadSize, uint64_t elapsed)
+{
+    const char* messageName = StringPool::intern(name);
+
+    Record& record = m_ring[m_recordCount++ % RingSize];
+    record.timestamp = now();
+    record.elapsed = elapsed;
+    record.payloadSize = payloadSize;
+    record.direction = direction;
+    record.messageName = messageName;
+
+    Counters& counters = m_stats[messageName].directions[direction];
+    counters.count++;
+    counters.bytes += payloadSize;
+    counters.time += elapsed;
+    counters.maxTime = std::max(counters.maxTime, elapsed);
+}
+
+void IPCTracer::recordRoundTrip(uint64_t elapsed)
+{
+    if (!m_roundTrips || elapsed < m_roundTripMin)
+        m_roundTripMin = elapsed;
+    m_roundTripMax = std::max(m_roundTripMax, elapsed);
+    m_roundTripTime += elapsed;
+    m_roundTrips++;
+}
+
+static double toMicroseconds(uint64_t nanoseconds)
+{
+    return nanoseconds / 1000.0;
+}
+
+void IPCTracer::dump(std::ostream& out) const
+{
+    typedef std::pair<const char*, MessageStats> Entry;
+    std::vector<Entry> entries(m_stats.begin(), m_stats.end());
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.second.directions[Outgoing].count + a.second.directions[Incoming].count
+            > b.second.directions[Outgoing].count + b.second.directions[Incoming].count;
+    });
+
+    out << "IPC trace for " << m_processName << std::endl;
+    out << std::fixed << std::setprecision(1);
+    for (const Entry& entry : entries) {
+        for (int direction = Outgoing; direction <= Incoming; ++direction) {
+            const Counters& counters = entry.second.directions[direction];
+            if (!counters.count)
+                continue;
+            out << "  " << (direction == Outgoing ? "-> " : "<- ") << std::left << std::setw(28) << entry.first << std::right
+                << " count " << std::setw(8) << counters.count
+                << " bytes " << std::setw(10) << counters.bytes
+                << " avg " << std::setw(8) << toMicroseconds(counters.time / counters.count) << "us"
+                << " max " << std::setw(8) << toMicroseconds(counters.maxTime) << "us" << std::endl;
+        }
+    }
+
+    if (m_roundTrips) {
+        out << "  round trip: " << m_roundTrips << " pings, avg " << toMicroseconds(m_roundTripTime / m_roundTrips)
+            << "us, min " << toMicroseconds(m_roundTripMin) << "us, max " << toMicroseconds(m_roundTripMax) << "us" << std::endl;
+    }
+
+    uint64_t first = m_recordCount > RingSize ? m_recordCount - RingSize : 0;
+    out << "  last " << m_recordCount - first << " messages:" << std::endl;
+    for (uint64_t i = first; i < m_recordCount; ++i) {
+        const Record& record = m_ring[i % RingSize];
+        out << "    " << record.timestamp / 1000000 << "ms " << (record.direction == Outgoing ? "-> " : "<- ")
+            << record.messageName << " " << record.payloadSize << " bytes, " << toMicroseconds(record.elapsed) << "us" << std::endl;
+    }
+}
+
+void IPCTracer::printSummary(std::ostream& out)
+{
+    uint64_t currentTime = now();
+    uint64_t total = 0;
+    uint64_t bytes = 0;
+    const char* chattiest = 0;
+    uint64_t chattiestCount = 0;
+
+    for (std::pair<const char* const, MessageStats>& entry : m_stats) {
+        MessageStats& stats = entry.second;
+        uint64_t count = stats.directions[Outgoing].count + stats.directions[Incoming].count;
+        uint64_t delta = count - stats.countAtLastSummary;
+        stats.countAtLastSummary = count;
+
+        total += delta;
+        bytes += stats.directions[Outgoing].bytes + stats.directions[Incoming].bytes;
+        if (delta > chattiestCount) {
+            chattiest = entry.first;
+            chattiestCount = delta;
+        }
+    }
+
+    double seconds = (currentTime - m_lastSummaryTime) / 1e9;
+    m_lastSummaryTime = currentTime;
+
+    out << "[IPC " << m_processName << "] " << total << " messages in " << std::fixed << std::setprecision(1) << seconds << "s";
+    if (chattiest)
+        out << ", chattiest " << chattiest << " (" << chattiestCount << ")";
+    out << ", " << bytes << " bytes total";
+    if (m_roundTrips)
+        out << ", round trip avg " << toMicroseconds(m_roundTripTime / m_roundTrips) << "us";
+    out << std::endl;
+}
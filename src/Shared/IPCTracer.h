@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef IPCTracer_h
+#define IPCTracer_h
+
+#include <cstddef>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <WebKit2/WKType.h>
+#include "WKConversions.h"
+
+// Keeps account of the messages going through the injected bundle channels.
+// It's disabled unless DROWSER_IPC_TRACE is set, so the cost on the message
+// paths is a single branch. Not thread safe, only use it from the main thread.
+class IPCTracer
+{
+public:
+    enum Direction {
+        Outgoing,
+        Incoming
+    };
+
+    static IPCTracer& instance();
+
+    bool isEnabled() const { return m_enabled; }
+    // Seconds between periodic summaries, zero means no summaries.
+    unsigned summaryInterval() const { return m_summaryInterval; }
+    void setProcessName(const char* name) { m_processName = name; }
+
+    // elapsed is the time spent encoding an outgoing message or decoding and
+    // dispatching an incoming one, in nanoseconds.
+    void record(Direction, StringView messageName, size_t payloadSize, uint64_t elapsed);
+    void recordRoundTrip(uint64_t elapsed);
+
+    void dump(std::ostream&) const;
+    void printSummary(std::ostream&);
+
+    // Nanoseconds from a monotonic clock, comparable between processes.
+    static uint64_t now();
+    // Rough size of the payload once serialized.
+    static size_t payloadSize(WKTypeRef);
+
+private:
+    IPCTracer();
+
+    struct Counters {
+        Counters() : count(0), bytes(0), time(0), maxTime(0) {}
+        uint64_t count;
+        uint64_t bytes;
+        uint64_t time;
+        uint64_t maxTime;
+    };
+
+    struct MessageStats {
+        MessageStats() : countAtLastSummary(0) {}
+        Counters directions[2];
+        uint64_t countAtLastSummary;
+    };
+
+    struct Record {
+        uint64_t timestamp;
+        uint64_t elapsed;
+        uint32_t payloadSize;
+        uint32_t direction;
+        const char* messageName;
+    };
+
+    static const size_t RingSize = 1024;
+
+    bool m_enabled;
+    unsigned m_summaryInterval;
+    std::string m_processName;
+
+    // Keyed by interned message names.
+    std::unordered_map<const char*, MessageStats> m_stats;
+    Record m_ring[RingSize];
+    uint64_t m_recordCount;
+
+    uint64_t m_roundTrips;
+    uint64_t m_roundTripTime;
+    uint64_t m_roundTripMin;
+    uint64_t m_roundTripMax;
+    uint64_t m_lastSummaryTime;
+};
+
+#endif
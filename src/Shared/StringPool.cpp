@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "StringPool.h"
+#include <cstdlib>
+#include <vector>
+
+struct Entry {
+    size_t hash;
+    const char* string;
+    size_t length;
+};
+
+static const size_t initialTableSize = 256;
+static const size_t chunkSize = 4096;
+
+static std::vector<Entry>& table()
+{
+    static std::vector<Entry> entries(initialTableSize, Entry());
+    return entries;
+}
+
+static size_t entryCount = 0;
+static char* chunk = 0;
+static size_t chunkUsed = chunkSize;
+
+static size_t hash(StringView str)
+{
+    // FNV-1a
+    size_t result = 2166136261u;
+    for (size_t i = 0; i < str.length; ++i) {
+        result ^= static_cast<unsigned char>(str.data[i]);
+        result *= 16777619u;
+    }
+    return result;
+}
+
+static Entry& lookup(std::vector<Entry>& entries, StringView str, size_t strHash)
+{
+    size_t mask = entries.size() - 1;
+    for (size_t i = strHash & mask; ; i = (i + 1) & mask) {
+        Entry& entry = entries[i];
+        if (!entry.string || (entry.hash == strHash && StringView(entry.string, entry.length) == str))
+            return entry;
+    }
+}
+
+static const char* copyString(StringView str)
+{
+    // Strings are never freed, so just carve them out of big chunks.
+    size_t size = str.length + 1;
+    char* result;
+    if (size > chunkSize / 4) {
+        result = static_cast<char*>(malloc(size));
+    } else {
+        if (chunkUsed + size > chunkSize) {
+            chunk = static_cast<char*>(malloc(chunkSize));
+            chunkUsed = 0;
+        }
+        result = chunk + chunkUsed;
+        chunkUsed += size;
+    }
+    memcpy(result, str.data, str.length);
+    result[str.length] = 0;
+    return result;
+}
+
+static void grow()
+{
+    std::vector<Entry>& entries = table();
+    std::vector<Entry> newEntries(entries.size() * 2, Entry());
+    for (const Entry& entry : entries) {
+        if (entry.string)
+            lookup(newEntries, StringView(entry.string, entry.length), entry.hash) = entry;
+    }
+    entries.swap(newEntries);
+}
+
+const char* StringPool::find(StringView str)
+{
+    return lookup(table(), str, hash(str)).string;
+}
+
+const char* StringPool::intern(StringView str)
+{
+    size_t strHash = hash(str);
+    Entry& entry = lookup(table(), str, strHash);
+    if (entry.string)
+        return entry.string;
+
+    entry.hash = strHash;
+    entry.string = copyString(str);
+    entry.length = str.length;
+    const char* result = entry.string;
+
+    // Keep the load factor under 3/4.
+    if (++entryCount * 4 > table().size() * 3)
+        grow();
+    return result;
+}
@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "VectorMath.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HAVE_NEON 1
+#endif
+
+namespace VectorMath {
+
+static bool baselineInstructionsOnly = false;
+
+void useBaselineInstructionsOnly(bool baselineOnly)
+{
+    baselineInstructionsOnly = baselineOnly;
+}
+
+#if HAVE_X86_SIMD
+static bool cpuSupportsAVX2()
+{
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported && !baselineInstructionsOnly;
+}
+#endif
+
+static void interleaveGeneric(const float* const* sources, unsigned numberOfChannels, float* destination, size_t framesToProcess)
+{
+    for (unsigned channel = 0; channel < numberOfChannels; ++channel) {
+        const float* source = sources[channel];
+        float* output = destination + channel;
+        for (size_t i = 0; i < framesToProcess; ++i, output += numberOfChannels)
+            *output = source[i];
+    }
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t interleaveStereoAVX2(const float* left, const float* right, float* destination, size_t framesToProcess)
+{
+    size_t i = 0;
+    for (; i + 8 <= framesToProcess; i += 8) {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        // unpack works within 128 bit lanes: low = l0 r0 l1 r1 | l4 r4 l5 r5, high = l2 r2 l3 r3 | l6 r6 l7 r7.
+        __m256 low = _mm256_unpacklo_ps(l, r);
+        __m256 high = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(destination + 2 * i, _mm256_permute2f128_ps(low, high, 0x20));
+        _mm256_storeu_ps(destination + 2 * i + 8, _mm256_permute2f128_ps(low, high, 0x31));
+    }
+    return i;
+}
+#endif
+
+static void interleaveStereo(const float* left, const float* right, float* destination, size_t framesToProcess)
+{
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        i = interleaveStereoAVX2(left, right, destination, framesToProcess);
+    for (; i + 4 <= framesToProcess; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(destination + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(destination + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+#elif HAVE_NEON
+    for (; i + 4 <= framesToProcess; i += 4) {
+        float32x4x2_t frames = { { vld1q_f32(left + i), vld1q_f32(right + i) } };
+        vst2q_f32(destination + 2 * i, frames);
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        destination[2 * i] = left[i];
+        destination[2 * i + 1] = right[i];
+    }
+}
+
+static void interleaveQuad(const float* const* sources, float* destination, size_t framesToProcess)
+{
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    for (; i + 4 <= framesToProcess; i += 4) {
+        // Each register holds 4 frames of a channel, transposing gives 4 interleaved frames.
+        __m128 c0 = _mm_loadu_ps(sources[0] + i);
+        __m128 c1 = _mm_loadu_ps(sources[1] + i);
+        __m128 c2 = _mm_loadu_ps(sources[2] + i);
+        __m128 c3 = _mm_loadu_ps(sources[3] + i);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(destination + 4 * i, c0);
+        _mm_storeu_ps(destination + 4 * i + 4, c1);
+        _mm_storeu_ps(destination + 4 * i + 8, c2);
+        _mm_storeu_ps(destination + 4 * i + 12, c3);
+    }
+#elif HAVE_NEON
+    for (; i + 4 <= framesToProcess; i += 4) {
+        float32x4x4_t frames = { { vld1q_f32(sources[0] + i), vld1q_f32(sources[1] + i), vld1q_f32(sources[2] + i), vld1q_f32(sources[3] + i) } };
+        vst4q_f32(destination + 4 * i, frames);
+    }
+#endif
+    if (i < framesToProcess) {
+        const float* rest[4] = { sources[0] + i, sources[1] + i, sources[2] + i, sources[3] + i };
+        interleaveGeneric(rest, 4, destination + 4 * i, framesToProcess - i);
+    }
+}
+
+void interleave(const float* const* sources, unsigned numberOfChannels, float* destination, size_t framesToProcess)
+{
+    switch (numberOfChannels) {
+    case 1:
+        memcpy(destination, sources[0], framesToProcess * sizeof(float));
+        break;
+    case 2:
+        interleaveStereo(sources[0], sources[1], destination, framesToProcess);
+        break;
+    case 4:
+        interleaveQuad(sources, destination, framesToProcess);
+        break;
+    default:
+        interleaveGeneric(sources, numberOfChannels, destination, framesToProcess);
+        break;
+    }
+}
+
+static void deinterleaveGeneric(const float* source, unsigned numberOfChannels, float* const* destinations, size_t framesToProcess)
+{
+    for (unsigned channel = 0; channel < numberOfChannels; ++channel) {
+        const float* input = source + channel;
+        float* destination = destinations[channel];
+        for (size_t i = 0; i < framesToProcess; ++i, input += numberOfChannels)
+            destination[i] = *input;
+    }
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t deinterleaveStereoAVX2(const float* source, float* left, float* right, size_t framesToProcess)
+{
+    size_t i = 0;
+    for (; i + 8 <= framesToProcess; i += 8) {
+        __m256 low = _mm256_loadu_ps(source + 2 * i);
+        __m256 high = _mm256_loadu_ps(source + 2 * i + 8);
+        // shuffle works within 128 bit lanes, giving l0 l1 l4 l5 | l2 l3 l6 l7, the permute puts the pairs back in order.
+        __m256 l = _mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+        _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    return i;
+}
+#endif
+
+static void deinterleaveStereo(const float* source, float* left, float* right, size_t framesToProcess)
+{
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        i = deinterleaveStereoAVX2(source, left, right, framesToProcess);
+    for (; i + 4 <= framesToProcess; i += 4) {
+        __m128 low = _mm_loadu_ps(source + 2 * i);
+        __m128 high = _mm_loadu_ps(source + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+#elif HAVE_NEON
+    for (; i + 4 <= framesToProcess; i += 4) {
+        float32x4x2_t frames = vld2q_f32(source + 2 * i);
+        vst1q_f32(left + i, frames.val[0]);
+        vst1q_f32(right + i, frames.val[1]);
+    }
+#endif
+    for (; i < framesToProcess; ++i) {
+        left[i] = source[2 * i];
+        right[i] = source[2 * i + 1];
+    }
+}
+
+void deinterleave(const float* source, unsigned numberOfChannels, float* const* destinations, size_t framesToProcess)
+{
+    switch (numberOfChannels) {
+    case 1:
+        memcpy(destinations[0], source, framesToProcess * sizeof(float));
+        break;
+    case 2:
+        deinterleaveStereo(source, destinations[0], destinations[1], framesToProcess);
+        break;
+    default:
+        deinterleaveGeneric(source, numberOfChannels, destinations, framesToProcess);
+        break;
+    }
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t addAVX2(const float* source, float* destination, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(destination + i, _mm256_add_ps(_mm256_loadu_ps(destination + i), _mm256_loadu_ps(source + i)));
+    return i;
+}
+#endif
+
+void add(const float* source, float* destination, size_t count)
+{
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        i = addAVX2(source, destination, count);
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(destination + i, _mm_add_ps(_mm_loadu_ps(destination + i), _mm_loadu_ps(source + i)));
+#elif HAVE_NEON
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(destination + i, vaddq_f32(vld1q_f32(destination + i), vld1q_f32(source + i)));
+#endif
+    for (; i < count; ++i)
+        destination[i] += source[i];
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static float dotProductAVX2(const float* a, const float* b, size_t count, size_t& processed)
+{
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    processed = i;
+    return _mm_cvtss_f32(half);
+}
+#endif
+
+float dotProduct(const float* a, const float* b, size_t count)
+{
+    float result = 0;
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        result = dotProductAVX2(a, b, count, i);
+    __m128 sum = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    result += _mm_cvtss_f32(sum);
+#elif HAVE_NEON
+    float32x4_t sum = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4)
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    result = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+    for (; i < count; ++i)
+        result += a[i] * b[i];
+    return result;
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static float maximumMagnitudeAVX2(const float* source, size_t count, size_t& processed)
+{
+    const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 maximum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        maximum = _mm256_max_ps(maximum, _mm256_and_ps(_mm256_loadu_ps(source + i), mask));
+    __m128 half = _mm_max_ps(_mm256_castps256_ps128(maximum), _mm256_extractf128_ps(maximum, 1));
+    half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+    processed = i;
+    return _mm_cvtss_f32(half);
+}
+#endif
+
+float maximumMagnitude(const float* source, size_t count)
+{
+    float result = 0;
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        result = maximumMagnitudeAVX2(source, count, i);
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 maximum = _mm_set1_ps(result);
+    for (; i + 4 <= count; i += 4)
+        maximum = _mm_max_ps(maximum, _mm_and_ps(_mm_loadu_ps(source + i), mask));
+    maximum = _mm_max_ps(maximum, _mm_movehl_ps(maximum, maximum));
+    maximum = _mm_max_ss(maximum, _mm_shuffle_ps(maximum, maximum, 1));
+    result = _mm_cvtss_f32(maximum);
+#elif HAVE_NEON
+    float32x4_t maximum = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4)
+        maximum = vmaxq_f32(maximum, vabsq_f32(vld1q_f32(source + i)));
+    float32x2_t pair = vmax_f32(vget_low_f32(maximum), vget_high_f32(maximum));
+    result = vget_lane_f32(vpmax_f32(pair, pair), 0);
+#endif
+    for (; i < count; ++i) {
+        float magnitude = source[i] < 0 ? -source[i] : source[i];
+        if (magnitude > result)
+            result = magnitude;
+    }
+    return result;
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t complexMultiplyAVX2(const float* realA, const float* imagA, const float* realB, const float* imagB, float* realDestination, float* imagDestination, size_t count)
+{
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ar = _mm256_loadu_ps(realA + i);
+        __m256 ai = _mm256_loadu_ps(imagA + i);
+        __m256 br = _mm256_loadu_ps(realB + i);
+        __m256 bi = _mm256_loadu_ps(imagB + i);
+        _mm256_storeu_ps(realDestination + i, _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi)));
+        _mm256_storeu_ps(imagDestination + i, _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br)));
+    }
+    return i;
+}
+#endif
+
+void complexMultiply(const float* realA, const float* imagA, const float* realB, const float* imagB, float* realDestination, float* imagDestination, size_t count)
+{
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        i = complexMultiplyAVX2(realA, imagA, realB, imagB, realDestination, imagDestination, count);
+    for (; i + 4 <= count; i += 4) {
+        __m128 ar = _mm_loadu_ps(realA + i);
+        __m128 ai = _mm_loadu_ps(imagA + i);
+        __m128 br = _mm_loadu_ps(realB + i);
+        __m128 bi = _mm_loadu_ps(imagB + i);
+        _mm_storeu_ps(realDestination + i, _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi)));
+        _mm_storeu_ps(imagDestination + i, _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br)));
+    }
+#elif HAVE_NEON
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t ar = vld1q_f32(realA + i);
+        float32x4_t ai = vld1q_f32(imagA + i);
+        float32x4_t br = vld1q_f32(realB + i);
+        float32x4_t bi = vld1q_f32(imagB + i);
+        vst1q_f32(realDestination + i, vmlsq_f32(vmulq_f32(ar, br), ai, bi));
+        vst1q_f32(imagDestination + i, vmlaq_f32(vmulq_f32(ar, bi), ai, br));
+    }
+#endif
+    for (; i < count; ++i) {
+        float real = realA[i] * realB[i] - imagA[i] * imagB[i];
+        float imag = realA[i] * imagB[i] + imagA[i] * realB[i];
+        realDestination[i] = real;
+        imagDestination[i] = imag;
+    }
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static size_t int16ToFloatAVX2(const int16_t* source, float* destination, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+        _mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+    }
+    return i;
+}
+#endif
+
+void int16ToFloat(const int16_t* source, float* destination, size_t count)
+{
+    const float scale = 1.0f / 32768;
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsAVX2())
+        i = int16ToFloatAVX2(source, destination, count);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; i + 8 <= count; i += 8) {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        // Each sample in the high half of a 32 bit lane, shifted back down with its sign.
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale4));
+        _mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale4));
+    }
+#elif HAVE_NEON
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t samples = vld1q_s16(source + i);
+        vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), scale));
+        vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), scale));
+    }
+#endif
+    for (; i < count; ++i)
+        destination[i] = source[i] * scale;
+}
+
+#if HAVE_X86_SIMD
+__attribute__((target("ssse3")))
+static size_t int24ToFloatSSSE3(const uint8_t* source, float* destination, size_t count)
+{
+    // Moves the 3 bytes of each sample to the top of a 32 bit lane, -1 zeroes the low byte.
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128 scale = _mm_set1_ps(1.0f / 8388608);
+    size_t i = 0;
+    // The 16 byte loads read 4 bytes past the 4 samples they convert.
+    for (; i + 6 <= count; i += 4) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * i));
+        __m128i samples = _mm_srai_epi32(_mm_shuffle_epi8(bytes, shuffle), 8);
+        _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+    }
+    return i;
+}
+
+static bool cpuSupportsSSSE3()
+{
+    static bool supported = __builtin_cpu_supports("ssse3");
+    return supported && !baselineInstructionsOnly;
+}
+#endif
+
+void int24ToFloat(const uint8_t* source, float* destination, size_t count)
+{
+    const float scale = 1.0f / 8388608;
+    size_t i = 0;
+#if HAVE_X86_SIMD
+    if (cpuSupportsSSSE3())
+        i = int24ToFloatSSSE3(source, destination, count);
+#elif HAVE_NEON
+    for (; i + 8 <= count; i += 8) {
+        // Splits the bytes of 8 samples in 3 registers, then puts each sample
+        // together at the top of a 32 bit lane to shift it back down with its sign.
+        uint8x8x3_t bytes = vld3_u8(source + 3 * i);
+        uint16x8_t byte0 = vmovl_u8(bytes.val[0]);
+        uint16x8_t byte1 = vmovl_u8(bytes.val[1]);
+        uint16x8_t byte2 = vmovl_u8(bytes.val[2]);
+        uint32x4_t low = vorrq_u32(vorrq_u32(vshll_n_u16(vget_low_u16(byte0), 8), vshll_n_u16(vget_low_u16(byte1), 16)),
+                                   vshlq_n_u32(vmovl_u16(vget_low_u16(byte2)), 24));
+        uint32x4_t high = vorrq_u32(vorrq_u32(vshll_n_u16(vget_high_u16(byte0), 8), vshll_n_u16(vget_high_u16(byte1), 16)),
+                                    vshlq_n_u32(vmovl_u16(vget_high_u16(byte2)), 24));
+        vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_s32(vshrq_n_s32(vreinterpretq_s32_u32(low), 8)), scale));
+        vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_s32(vshrq_n_s32(vreinterpretq_s32_u32(high), 8)), scale));
+    }
+#endif
+    for (; i < count; ++i) {
+        const uint8_t* bytes = source + 3 * i;
+        int32_t sample = static_cast<int32_t>(static_cast<uint32_t>(bytes[0]) << 8 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 24) >> 8;
+        destination[i] = sample * scale;
+    }
+}
+
+}
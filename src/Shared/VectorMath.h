@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2013 Nokia Corporation and/or its subsidiary(-ies).
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VectorMath_h
+#define VectorMath_h
+
+#include <cstddef>
+#include <stdint.h>
+
+// Audio kernels with SSE2/AVX2 or NEON implementations. The best variant for
+// the CPU we're running on is picked the first time a kernel is called.
+namespace VectorMath {
+
+// Interleaves numberOfChannels planar arrays of framesToProcess samples each.
+void interleave(const float* const* sources, unsigned numberOfChannels, float* destination, size_t framesToProcess);
+// The other way around, splits interleaved frames into numberOfChannels planar arrays.
+void deinterleave(const float* source, unsigned numberOfChannels, float* const* destinations, size_t framesToProcess);
+// destination[i] += source[i], for mixing streams of the same layout.
+void add(const float* source, float* destination, size_t count);
+// Sum of a[i] * b[i].
+float dotProduct(const float* a, const float* b, size_t count);
+// Largest absolute value of the count samples, zero for digital silence.
+float maximumMagnitude(const float* source, size_t count);
+// Element-wise product of two complex arrays in split real/imaginary form.
+// The destination may be either of the sources.
+void complexMultiply(const float* realA, const float* imagA, const float* realB, const float* imagB, float* realDestination, float* imagDestination, size_t count);
+// Sample conversions to floats in [-1, 1), for decoding PCM. Samples are in
+// host order, 24 bit ones packed in 3 little endian bytes.
+void int16ToFloat(const int16_t* source, float* destination, size_t count);
+void int24ToFloat(const uint8_t* source, float* destination, size_t count);
+
+// Keeps the kernels on the instructions every CPU of the architecture has
+// (SSE2, NEON), skipping the AVX2 and SSSE3 paths picked at runtime. Lets the
+// benchmarks time both on one machine.
+void useBaselineInstructionsOnly(bool);
+
+}
+
+#endif
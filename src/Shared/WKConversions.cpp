@@ -17,19 +17,44 @@ double fromWK(WKTypeRef value)
     return WKDoubleGetValue((WKDoubleRef)value);
 }
 
+bool fromWK(WKStringRef value, char* buffer, size_t bufferSize, StringView& result)
+{
+    if (!bufferSize)
+        return false;
+
+    // The size returned includes the null terminator. A completely filled buffer may
+    // mean the string was truncated, unless the worst case size was known to fit.
+    size_t realSize = WKStringGetUTF8CString(value, buffer, bufferSize);
+    if (realSize == bufferSize && WKStringGetMaximumUTF8CStringSize(value) >= bufferSize)
+        return false;
+
+    result = StringView(buffer, realSize ? realSize - 1 : 0);
+    buffer[result.length] = 0;
+    return true;
+}
+
 template<>
-std::string fromWK(WKTypeRef value)
+StringView fromWK(WKTypeRef value)
 {
+    static thread_local std::vector<char> scratch(256);
+
     WKStringRef wkStr = reinterpret_cast<WKStringRef>(value);
-    size_t wkStrSize = WKStringGetMaximumUTF8CStringSize(wkStr);
-    std::string result;
-    result.resize(wkStrSize + 1);
-    size_t realSize = WKStringGetUTF8CString(wkStr, &result[0], result.length());
-    if (realSize > 0)
-        result.resize(realSize - 1);
+    size_t maximumSize = WKStringGetMaximumUTF8CStringSize(wkStr) + 1;
+    if (scratch.size() < maximumSize)
+        scratch.resize(maximumSize);
+
+    StringView result;
+    fromWK(wkStr, scratch.data(), scratch.size(), result);
     return result;
 }
 
+template<>
+std::string fromWK(WKTypeRef value)
+{
+    StringView view = fromWK<StringView>(value);
+    return std::string(view.data, view.length);
+}
+
 template<>
 WKTypeRef toWK(const double& value)
 {
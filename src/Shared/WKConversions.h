@@ -27,11 +27,33 @@
 #define WKConvertions_h
 
 #include <cstddef>
+#include <cstring>
 #include <WebKit2/WKType.h>
 
+// Non owning reference to UTF-8 characters, the poor man's std::string_view.
+struct StringView {
+    StringView() : data(0), length(0) {}
+    StringView(const char* str) : data(str), length(strlen(str)) {}
+    StringView(const char* str, size_t size) : data(str), length(size) {}
+
+    bool operator==(const StringView& other) const { return length == other.length && !memcmp(data, other.data, length); }
+
+    const char* data;
+    size_t length;
+};
+
 template<typename T>
 T fromWK(WKTypeRef);
 
+// Converts into a thread local scratch buffer without allocating once the buffer
+// is big enough. The view, always null terminated, is valid until the next
+// conversion on the same thread.
+template<>
+StringView fromWK<StringView>(WKTypeRef);
+
+// Converts into a caller provided buffer, returns false if the string didn't fit.
+bool fromWK(WKStringRef, char* buffer, size_t bufferSize, StringView& result);
+
 WKTypeRef toWK(const char*);
 
 template<typename T>
@@ -33,7 +33,9 @@
 #include <WebKit2/WKStringPrivate.h>
 #include <WebKit2/WKType.h>
 #include <WebKit2/WKArray.h>
+#include "IPCTracer.h"
 #include "WKConversions.h"
+#include <glib.h>
 #include <cstdio>
 #include <cstring>
 #include <cassert>
@@ -67,6 +69,17 @@ Bundle::Bundle(WKBundleRef bundle)
     client.didReceiveMessageToPage = &Bundle::didReceiveMessageToPage;
 
     WKBundleSetClient(bundle, &client);
+
+    IPCTracer& tracer = IPCTracer::instance();
+    if (tracer.isEnabled()) {
+        tracer.setProcessName("UiBundle");
+        if (tracer.summaryInterval()) {
+            g_timeout_add_seconds(tracer.summaryInterval(), [](gpointer) -> gboolean {
+                IPCTracer::instance().printSummary(std::cerr);
+                return TRUE;
+            }, 0);
+        }
+    }
 }
 
 void Bundle::didClearWindowForFrame(WKBundlePageRef page, WKBundleFrameRef frame, WKBundleScriptWorldRef world, const void *clientInfo)
@@ -100,7 +113,23 @@ void Bundle::didCreatePage(WKBundleRef, WKBundlePageRef page, const void* client
 
 void Bundle::didReceiveMessageToPage(WKBundleRef, WKBundlePageRef, WKStringRef name, WKTypeRef messageBody, const void*)
 {
-    gBundle->callJSFunction(WKStringCopyJSString(name), gBundle->toJSVector(messageBody, ReverseOrder));
+    IPCTracer& tracer = IPCTracer::instance();
+    if (!tracer.isEnabled()) {
+        gBundle->callJSFunction(WKStringCopyJSString(name), gBundle->toJSVector(messageBody, ReverseOrder));
+        return;
+    }
+
+    uint64_t start = IPCTracer::now();
+    if (WKStringIsEqualToUTF8CString(name, "_ipcPing")) {
+        // A ping comes every summary interval, create the reply name only once.
+        static WKStringRef pongName = WKStringCreateWithUTF8CString("_ipcPong");
+        WKBundlePostMessage(gBundle->m_bundle, pongName, messageBody);
+    } else if (WKStringIsEqualToUTF8CString(name, "_dumpIpcStats"))
+        tracer.dump(std::cerr);
+    else
+        gBundle->callJSFunction(WKStringCopyJSString(name), gBundle->toJSVector(messageBody, ReverseOrder));
+
+    tracer.record(IPCTracer::Incoming, fromWK<StringView>(name), IPCTracer::payloadSize(messageBody), IPCTracer::now() - start);
 }
 
 void Bundle::registerAPI()
@@ -120,6 +149,11 @@ void Bundle::registerAPI()
     };
     for (int i = 0; funcs[i]; ++i)
         registerJSFunction(funcs[i]);
+
+    // Without tracing the Browser doesn't handle it, and untraced messages from
+    // the Browser all go to JS, so the two would bounce it back and forth.
+    if (IPCTracer::instance().isEnabled())
+        registerJSFunction("_dumpIpcStats");
 }
 
 void Bundle::registerJSFunction(const char* name)
@@ -190,6 +224,9 @@ static WKStringRef JSValueRefToWKStringRef(JSContextRef ctx, JSValueRef value)
 }
 
 JSValueRef Bundle::jsGenericCallback(JSContextRef ctx, JSObjectRef func, JSObjectRef thisObject, size_t argumentCount, const JSValueRef arguments[], JSValueRef*) {
+    IPCTracer& tracer = IPCTracer::instance();
+    uint64_t start = tracer.isEnabled() ? IPCTracer::now() : 0;
+
     WKTypeRef param = 0;
     if (argumentCount == 1) {
         JSType type = JSValueGetType(ctx, arguments[0]);
@@ -213,6 +250,8 @@ JSValueRef Bundle::jsGenericCallback(JSContextRef ctx, JSObjectRef func, JSObjec
     JSStringRelease(propName);
 
     WKStringRef funcName = JSValueRefToWKStringRef(ctx, propValue);
+    if (tracer.isEnabled())
+        tracer.record(IPCTracer::Outgoing, fromWK<StringView>(funcName), IPCTracer::payloadSize(param), IPCTracer::now() - start);
     WKBundlePostMessage(gBundle->m_bundle, funcName, param);
     if (param)
         WKRelease(param);
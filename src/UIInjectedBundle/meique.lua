@@ -1,9 +1,12 @@
 
 uiBundle = Library:new("UiBundle")
 uiBundle:usePackage(nix)
+uiBundle:usePackage(glib)
 uiBundle:addIncludePath("../Shared")
 uiBundle:addCustomFlags("-Wall -std=c++0x")
 uiBundle:addFiles([[
     Bundle.cpp
+    ../Shared/IPCTracer.cpp
+    ../Shared/StringPool.cpp
     ../Shared/WKConversions.cpp
 ]])
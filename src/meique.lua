@@ -2,6 +2,10 @@ glib = findPackage("glib-2.0", REQUIRED)
 openGL = findPackage("gl", REQUIRED)
 x11 = findPackage("x11", REQUIRED)
 nix = findPackage("WebKitNix", REQUIRED)
+gstreamer = findPackage("gstreamer-0.10", REQUIRED)
+gstreamerApp = findPackage("gstreamer-app-0.10", REQUIRED)
+gstreamerAudio = findPackage("gstreamer-audio-0.10", REQUIRED)
+gstreamerFft = findPackage("gstreamer-fft-0.10", REQUIRED)
 
 addSubdirectory("Browser")
 addSubdirectory("ContentsInjectedBundle")